@@ -1,1180 +1,7441 @@
 // dx_ball_visuals.cpp (bricks centered)
-// Compile: g++ dx_ball_visuals_centered_bricks.cpp -o dx_ball_visuals -lGL -lGLU -lglut
-#include <GL/glut.h>
+// Compile: g++ main.cpp -o dx_ball -lGL -lGLU -lglut -pthread
+// Deterministic Q16.16 physics: add -DDXB_FIXED_PHYSICS
+// Allocation tracking (no heap use in the tick or draw): add -DDXB_ALLOC_TRACK
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#include <mmsystem.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <GL/freeglut.h>
+#include <GL/glext.h>
 #include <stdbool.h>
 #include <math.h>
+#include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <random>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DXB_SSE 1
+#endif
+#if defined(DXB_ALLOC_TRACK) && defined(__GLIBC__)
+#include <execinfo.h>
+#endif
+#include <new>
 
 // -------------------------- Game config --------------------------
 enum GameState { STATE_MENU, STATE_INSTRUCTIONS, STATE_PLAYING, STATE_PAUSED, STATE_GAMEOVER, STATE_WIN };
 GameState state = STATE_MENU;
 
 // Paddle
-float paddleX = 0.0f;
-float paddleWidth = 0.30f;
 const float paddleHeight = 0.05f;
+const float PADDLE_START_WIDTH = 0.30f;
 const float PADDLE_MIN_WIDTH = 0.12f;
 const float PADDLE_MAX_WIDTH = 0.7f;
 
 // Ball
-float ballX = 0.0f, ballY = -0.5f;
-float ballDX = 0.008f, ballDY = 0.01f;
-float ballSpeedMultiplier = 1.0f;
-const float ballRadius = 0.03f;
-bool ballMoving = false;
+constexpr float ballRadius = 0.03f;
 
 // Ball trail (store last positions for simple motion blur)
 #define TRAIL_LEN 8
-float trailX[TRAIL_LEN];
-float trailY[TRAIL_LEN];
 
-// Bricks
+// Bricks (standard board; level files may use other sizes)
 #define ROWS 5
 #define COLS 8
-int bricks[ROWS][COLS];              // 1 = alive, 0 = removed
-float brickFade[ROWS][COLS];         // >0 means fading animation
-const float brickWidth = 0.22f;
-const float brickHeight = 0.08f;
-// spacing & computed start to center the grid
-float brickSpacingX = 0.02f;
-float brickSpacingY = 0.02f;
-float brickStartX = 0.0f; // computed so grid is centered
-float brickStartY = 0.0f; // computed so grid is centered
-
-// Score and Lives
-int score = 0;
-int lives = 3;
+constexpr float brickWidth = 0.22f;
+constexpr float brickHeight = 0.08f;
+// spacing between bricks on the standard board
+constexpr float brickSpacingX = 0.02f;
+constexpr float brickSpacingY = 0.02f;
 
 // Power-ups
 enum PowerType { POWER_EXTRA_LIFE = 0, POWER_FASTER_BALL = 1, POWER_WIDER_PADDLE = 2 };
-struct PowerUp
-{
-    bool visible;
-    PowerType type;
-    float x, y;
-    float vy;
-} powerUps[ROWS*COLS];
+#define MAX_POWERUPS 40
 
 // Power-up durations
-bool paddleWidened = false;
-int paddleWidenEndTimeMs = 0;
 const int PADDLE_WIDEN_DURATION_MS = 10000; // 10s
+const int FAST_BALL_DURATION_MS = 8000;     // per pickup; pickups stack
+const float FAST_BALL_FACTOR = 1.5f;
 
-// Time tracking
-int gameStartTimeMs = 0;
-int pauseStartTimeMs = 0;
-int totalPausedMs = 0;
+// Simulation step
+const int SIM_TICK_MS = 16;
 
 // Ball speed increase over time
-int lastSpeedIncreaseCheckMs = 0;
 const int SPEED_INCREASE_INTERVAL_MS = 5000;
 const float SPEED_INCREASE_FACTOR = 1.05f;
 
-// Window
-int g_winW = 900, g_winH = 700;
+// -------------------------- Physics scalar --------------------------
+// Ball, paddle and power-up state use `real`. By default that is float. Build with
+// -DDXB_FIXED_PHYSICS to make it Q16.16 fixed point: integer adds and multiplies,
+// table sine and integer sqrt, so a run gives bit-identical results with any
+// compiler, optimisation level or FPU. Tuning constants stay float and are
+// converted on use. Renderers read sim values through toF().
+#ifdef DXB_FIXED_PHYSICS
+struct Fixed
+{
+    int v;  // value * 65536
 
-// Pause menu buttons (normalized coords)
-typedef struct
+    constexpr Fixed() : v(0) {}
+    constexpr Fixed(float f) : v((int)(f * 65536.0f + (f >= 0.0f ? 0.5f : -0.5f))) {}
+    static constexpr Fixed raw(int r)
+    {
+        Fixed a;
+        a.v = r;
+        return a;
+    }
+};
+
+inline Fixed operator+(Fixed a, Fixed b) { return Fixed::raw(a.v + b.v); }
+inline Fixed operator-(Fixed a, Fixed b) { return Fixed::raw(a.v - b.v); }
+inline Fixed operator-(Fixed a) { return Fixed::raw(-a.v); }
+inline Fixed operator*(Fixed a, Fixed b) { return Fixed::raw((int)(((long long)a.v * b.v) >> 16)); }
+inline Fixed operator/(Fixed a, Fixed b) { return Fixed::raw((int)((long long)a.v * 65536 / b.v)); }
+inline Fixed& operator+=(Fixed& a, Fixed b) { a.v += b.v; return a; }
+inline Fixed& operator-=(Fixed& a, Fixed b) { a.v -= b.v; return a; }
+inline Fixed& operator*=(Fixed& a, Fixed b) { return a = a * b; }
+inline Fixed& operator/=(Fixed& a, Fixed b) { return a = a / b; }
+inline bool operator<(Fixed a, Fixed b) { return a.v < b.v; }
+inline bool operator>(Fixed a, Fixed b) { return a.v > b.v; }
+inline bool operator<=(Fixed a, Fixed b) { return a.v <= b.v; }
+inline bool operator>=(Fixed a, Fixed b) { return a.v >= b.v; }
+
+typedef Fixed real;
+#define PHYSICS_NAME "Q16.16"
+
+inline float toF(Fixed a) { return a.v * (1.0f / 65536.0f); }
+inline Fixed physAbs(Fixed a) { return Fixed::raw(a.v < 0 ? -a.v : a.v); }
+
+// Quarter-wave sine table, Q16.16, built at compile time from a Taylor series in
+// Q30 integer arithmetic so no libm result can leak into it.
+#define SIN_TABLE_SIZE 256
+#define HALF_PI_Q30 1686629713LL
+#define SIN_INDEX_SCALE ((long long)SIN_TABLE_SIZE * 65536 * (1LL << 30) / HALF_PI_Q30)  // Q16
+
+constexpr int sinQ16(long long x)   // x in Q30 radians, 0..pi/2
 {
-    float left, right, top, bottom;
-    const char* label;
-} Button;
-Button pauseButtons[3];
+    long long x2 = (x * x) >> 30;
+    long long term = x, sum = x;
+    for (int n = 1; n <= 6; ++n)
+    {
+        term = ((term * x2) >> 30) / ((2*n) * (2*n + 1));
+        sum += (n & 1) ? -term : term;
+    }
+    return (int)((sum + (1 << 13)) >> 14);
+}
 
-// Utility text
-void drawText(float x, float y, const char* text)
+struct SinTable
 {
-    glRasterPos2f(x, y);
-    for (const char* c = text; *c != '\0'; ++c)
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
+    int v[SIN_TABLE_SIZE + 2];  // one spare entry for interpolation at pi/2
+    constexpr SinTable() : v()
+    {
+        for (int i = 0; i < SIN_TABLE_SIZE + 2; ++i)
+            v[i] = sinQ16(HALF_PI_Q30 * i / SIN_TABLE_SIZE);
+    }
+};
+constexpr SinTable sinTable = SinTable();
+
+// |angle| is clamped to pi/2, which covers the paddle deflection range
+inline Fixed physSin(Fixed a)
+{
+    long long u = a.v < 0 ? -(long long)a.v : a.v;
+    if (u > (HALF_PI_Q30 >> 14)) u = HALF_PI_Q30 >> 14;
+    long long pos = (u * SIN_INDEX_SCALE) >> 16;   // table index, Q16
+    int i = (int)(pos >> 16);
+    int frac = (int)(pos & 0xffff);
+    int s = sinTable.v[i] + (int)(((long long)(sinTable.v[i + 1] - sinTable.v[i]) * frac) >> 16);
+    return Fixed::raw(a.v < 0 ? -s : s);
 }
 
-// -------------------------- Brick layout helper --------------------------
-void computeBrickLayout()
+inline Fixed physCos(Fixed a)
 {
-    float marginX = 0.05f;
-    float marginY = 0.10f; // top margin
+    return physSin(Fixed::raw((int)(HALF_PI_Q30 >> 14)) - physAbs(a));
+}
 
-    float totalW = COLS * brickWidth + (COLS - 1) * brickSpacingX;
-    float totalH = ROWS * brickHeight + (ROWS - 1) * brickSpacingY;
+inline Fixed physSqrt(Fixed a)
+{
+    if (a.v <= 0) return Fixed();
+    unsigned long long n = (unsigned long long)a.v << 16, r = 0, bit = 1ULL << 46;
+    while (bit > n) bit >>= 2;
+    while (bit)
+    {
+        if (n >= r + bit)
+        {
+            n -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else r >>= 1;
+        bit >>= 2;
+    }
+    return Fixed::raw((int)r);
+}
 
-    brickStartX = -totalW * 0.5f;
+inline int fastFloor(Fixed a) { return a.v >> 16; }
+#else
+typedef float real;
+#define PHYSICS_NAME "float"
+
+inline float toF(float a) { return a; }
+inline float physAbs(float a) { return fabsf(a); }
+inline float physSin(float a) { return sinf(a); }
+inline float physCos(float a) { return cosf(a); }
+inline float physSqrt(float a) { return sqrtf(a); }
+#endif
+
+// -------------------------- Allocation tracking --------------------------
+// -DDXB_ALLOC_TRACK replaces the global operator new and delete with versions
+// that count each allocation against the phase its thread is in. The game loop
+// marks its phases with AllocScope. Once allocArm() has been called the tick
+// and the draw must not allocate; any allocation there is a violation and the
+// first few keep their call stacks for the report printed at exit (link with
+// -rdynamic for function names). Without the flag AllocScope is empty and
+// nothing is hooked.
+enum AllocPhase { PHASE_OTHER, PHASE_INPUT, PHASE_TICK, PHASE_DRAW, PHASE_COUNT };
+
+#ifdef DXB_ALLOC_TRACK
+#define ALLOC_MAX_STACKS 8
+#define ALLOC_STACK_DEPTH 24
+
+const char* allocPhaseNames[PHASE_COUNT] = { "other", "input", "tick", "draw" };
+
+// Zero-initialised statics only: the hooks run before any constructor does
+struct AllocStats
+{
+    std::atomic<unsigned long long> count[PHASE_COUNT][2];  // [phase][armed]
+    std::atomic<unsigned long long> bytes[PHASE_COUNT][2];
+    std::atomic<int> violations;
+    void* stack[ALLOC_MAX_STACKS][ALLOC_STACK_DEPTH];
+    int depth[ALLOC_MAX_STACKS];
+    AllocPhase phase[ALLOC_MAX_STACKS];
+    size_t size[ALLOC_MAX_STACKS];
+};
+AllocStats allocStats;
+std::atomic<bool> allocArmed;
+thread_local AllocPhase allocPhase = PHASE_OTHER;
+
+void allocNote(size_t n)
+{
+    AllocPhase ph = allocPhase;
+    int armed = allocArmed.load(std::memory_order_relaxed);
+    allocStats.count[ph][armed].fetch_add(1, std::memory_order_relaxed);
+    allocStats.bytes[ph][armed].fetch_add(n, std::memory_order_relaxed);
+    if (!armed || (ph != PHASE_TICK && ph != PHASE_DRAW)) return;
+    int k = allocStats.violations.fetch_add(1);
+    if (k >= ALLOC_MAX_STACKS) return;
+    allocStats.phase[k] = ph;
+    allocStats.size[k] = n;
+#if defined(__GLIBC__)
+    allocStats.depth[k] = backtrace(allocStats.stack[k], ALLOC_STACK_DEPTH);
+#elif defined(_WIN32)
+    allocStats.depth[k] = CaptureStackBackTrace(1, ALLOC_STACK_DEPTH, allocStats.stack[k], NULL);
+#endif
+}
 
-    brickStartY = 1.0f - marginY;
-    brickStartY -= (brickHeight * 0.5f);
+void* allocTracked(size_t n)
+{
+    allocNote(n);
+    return malloc(n ? n : 1);
+}
 
-    // extra downward shift
-    brickStartY -= 0.05f;
+void* operator new(size_t n)
+{
+    void* p = allocTracked(n);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t n)
+{
+    void* p = allocTracked(n);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void* operator new(size_t n, const std::nothrow_t&) noexcept { return allocTracked(n); }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { return allocTracked(n); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// From here on the tick and the draw must not allocate
+void allocArm()
+{
+#if defined(__GLIBC__)
+    void* warm[1];
+    backtrace(warm, 1);     // the first call loads the unwinder, which allocates
+#endif
+    allocArmed.store(true);
 }
 
-// -------------------------- Game control --------------------------
-void resetBall()
-{
-    ballX = 0.0f;
-    ballY = -0.5f;
-    ballDX = 0.008f * ((rand() % 2) ? 1.0f : -1.0f);
-    ballDY = 0.01f;
-    ballSpeedMultiplier = 1.0f;
-    ballMoving = false;
-    // clear trail
-    for (int i = 0; i < TRAIL_LEN; ++i)
+// Per-phase totals and the stacks of the first violations; false if there were any
+bool allocReport()
+{
+    for (int ph = 0; ph < PHASE_COUNT; ++ph)
+        printf("alloc %-5s: %llu allocations (%llu bytes) warming up, %llu (%llu bytes) after\n",
+               allocPhaseNames[ph],
+               allocStats.count[ph][0].load(), allocStats.bytes[ph][0].load(),
+               allocStats.count[ph][1].load(), allocStats.bytes[ph][1].load());
+    int n = allocStats.violations.load();
+    for (int k = 0; k < std::min(n, ALLOC_MAX_STACKS); ++k)
     {
-        trailX[i] = ballX;
-        trailY[i] = ballY;
+        printf("alloc: %zu bytes in the %s phase from\n", allocStats.size[k], allocPhaseNames[allocStats.phase[k]]);
+        fflush(stdout);
+#if defined(__GLIBC__)
+        backtrace_symbols_fd(allocStats.stack[k], allocStats.depth[k], 1);
+#else
+        for (int d = 0; d < allocStats.depth[k]; ++d) printf("  %p\n", allocStats.stack[k][d]);
+#endif
     }
+    if (n > 0) printf("alloc: %d allocations in the tick or draw after warm-up FAIL\n", n);
+    fflush(stdout);
+    return n == 0;
 }
 
-void resetGame()
+// Registered first, so it runs after everything else has shut down
+void allocReportAtExit()
 {
-    score = 0;
-    lives = 3;
-    paddleWidth = 0.30f;
-    paddleWidened = false;
-    paddleWidenEndTimeMs = 0;
-    totalPausedMs = 0;
-    gameStartTimeMs = glutGet(GLUT_ELAPSED_TIME);
-    lastSpeedIncreaseCheckMs = gameStartTimeMs;
-    for (int i=0; i<ROWS; ++i) for (int j=0; j<COLS; ++j)
-        {
-            bricks[i][j] = 1;
-            brickFade[i][j] = 0.0f;
-        }
-    for (int i=0; i<ROWS*COLS; ++i) powerUps[i].visible = false;
-    computeBrickLayout();
-    resetBall();
+    if (!allocReport()) _Exit(2);
 }
 
-// -------------------------- Visual improvements --------------------------
+struct AllocScope
+{
+    AllocPhase saved;
+    explicit AllocScope(AllocPhase p) : saved(allocPhase) { allocPhase = p; }
+    ~AllocScope() { allocPhase = saved; }
+};
+#else
+inline void allocArm() {}
+struct AllocScope
+{
+    explicit AllocScope(AllocPhase) {}
+};
+#endif
+
+// -------------------------- World (entity/component storage) --------------------------
+// All simulation state lives in a World instead of file-scope globals, so several
+// games can exist in one process (headless rollouts, batch runs). Each entity kind
+// is an archetype whose components are stored as dense parallel arrays; systems
+// walk them front to back.
+
+// Brick archetype: one packed byte per grid cell (index = row*cols + col).
+// All bricks share one collider size and sit on a regular lattice, so their
+// transforms come from the layout rather than per-brick arrays. Type and hit
+// points share the byte, so collision reads a row of bricks from one cache line.
+#define BRICK_HP(c)   ((c) & 0x0f)   // hit points, 0 = no brick
+#define BRICK_TYPE(c) ((c) >> 4)
+#define BRICK_CELL(type, hp) (unsigned char)(((type) << 4) | (hp))
+enum BrickType
+{
+    BRICK_NORMAL = 0,       // loses a hit point per hit; more than one = multi-hit
+    BRICK_STEEL = 1,        // indestructible, doesn't count towards the win
+    BRICK_EXPLOSIVE = 2,    // destroys its eight neighbours when it goes
+    BRICK_POWERUP = 3,      // always drops a power-up
+    BRICK_BLASTING = 4      // internal: explosive waiting in the blast queue, hp 0
+};
+#define BRICK_BREAKABLE(c) (BRICK_HP(c) && BRICK_TYPE(c) != BRICK_STEEL)
+#define BRICK_BLAST_MARK BRICK_CELL(BRICK_BLASTING, 0)
+struct BrickStore
+{
+    int rows, cols;
+    unsigned char* cell;        // rows*cols bytes, may point into a mapped level file
+    int aliveCount;             // breakable bricks left
+    // layout
+    float startX, startY;       // top-left corner of cell (0,0)
+    float pitchX, pitchY;       // distance between neighbouring cells
+    float invPitchX, invPitchY;
+    float w, h;                 // collider extents
+    float ceilY;                // top wall; above 1 for boards taller than the screen
+    int liveTop, liveBottom;    // no brick outside these rows (only ever narrowed)
+};
+
+inline float brickX(const BrickStore& bs, int col) { return bs.startX + col * bs.pitchX; }
+inline float brickY(const BrickStore& bs, int row) { return bs.startY - row * bs.pitchY; }
+
+// Power-up archetype: packed, removed by swapping with the last entry
+struct PowerUpStore
+{
+    int count;
+    real x[MAX_POWERUPS], y[MAX_POWERUPS];   // transform
+    real vy[MAX_POWERUPS];                   // velocity
+    PowerType type[MAX_POWERUPS];
+};
+
+// Timed effects: a min-heap on deadline, so a tick only looks at the top.
+// Deadlines are on the game clock (wall time minus totalPausedMs). The kind
+// says what to undo on expiry; the speed ramp re-arms itself.
+enum EffectKind { EFFECT_SPEED_RAMP, EFFECT_WIDE_PADDLE, EFFECT_FAST_BALL };
+#define MAX_EFFECTS 32
+struct TimedEffect
+{
+    int deadlineMs;
+    EffectKind kind;
+};
+struct EffectStore
+{
+    int count;
+    TimedEffect heap[MAX_EFFECTS];
+};
 
-void drawInstructionsOverlay()
+struct Ball
 {
-    // dim background
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glColor4f(0,0,0,0.7f);
-    glBegin(GL_QUADS);
-    glVertex2f(-1,-1);
-    glVertex2f(1,-1);
-    glVertex2f(1,1);
-    glVertex2f(-1,1);
-    glEnd();
-    glDisable(GL_BLEND);
+    real x, y;
+    real dx, dy;
+    real speedMul;
+    bool moving;
+    real trailX[TRAIL_LEN];
+    real trailY[TRAIL_LEN];
+};
+
+struct Paddle
+{
+    real x;
+    real width;
+};
+
+// Things that happened during one step, for the app layer (animations, UI)
+enum WorldEventKind
+{
+    EV_BRICK_DESTROYED, EV_BRICK_DAMAGED, EV_BRICK_EXPLODED,
+    EV_PADDLE_HIT, EV_POWERUP_SPAWNED, EV_POWERUP_COLLECTED, EV_LIFE_LOST, EV_WIN, EV_GAMEOVER
+};
+struct WorldEvent
+{
+    WorldEventKind kind;
+    int a, b;           // brick row/col, power-up type
+    int count;          // 1, except for what a chain did: bricks it destroyed
+                        // (EV_BRICK_EXPLODED), power-ups they dropped (EV_POWERUP_SPAWNED)
+    unsigned int seq;   // EV_BRICK_EXPLODED: the journal entry of its first brick
+};
+#define MAX_WORLD_EVENTS 32
+
+// Explosive chains are resolved through a fixed ring of cell indices (power of two)
+#define MAX_BLAST_QUEUE 1024
+
+// Brick journal: every change the simulation makes to a cell, in order, for
+// consumers that follow the board instead of rescanning it (the shader path's
+// brick buffer, mirrors, observers). A fixed ring; sequence numbers only grow,
+// so a consumer keeps the one it has read up to and catches up from there. One
+// that falls a whole ring behind, or whose board was replaced, rebuilds from
+// the cells. Entries carry the cell's value as of the end of the tick.
+enum BrickChangeKind { CHANGE_DAMAGED, CHANGE_DESTROYED };  // destroyed = fade starts
+struct BrickChange
+{
+    int cell;               // row * cols + col
+    unsigned char kind;     // BrickChangeKind
+    unsigned char value;
+};
+#define BRICK_JOURNAL_SIZE 256      // power of two
+struct BrickJournal
+{
+    BrickChange ring[BRICK_JOURNAL_SIZE];
+    unsigned int head;          // changes written
+    unsigned int tickStart;     // head when the last tick began
+    unsigned int board;         // new for every setBoard
+};
 
-    // panel
-    float panelW = 0.7f, panelH = 0.6f;
-    glColor3f(0.1f,0.1f,0.15f);
-    glBegin(GL_QUADS);
-    glVertex2f(-panelW/2, panelH/2);
-    glVertex2f(panelW/2, panelH/2);
-    glVertex2f(panelW/2, -panelH/2);
-    glVertex2f(-panelW/2, -panelH/2);
-    glEnd();
+struct World
+{
+    Paddle paddle;
+    Ball ball;
+    BrickStore bricks;
+    BrickJournal journal;
+    PowerUpStore powerUps;
+    EffectStore effects;
+    std::vector<unsigned char> ownedCells;  // brick cells when not using a mapped level
+
+    int score;
+    int lives;
+
+    // Time tracking
+    int gameStartTimeMs;
+    int pauseStartTimeMs;
+    int totalPausedMs;
+
+    unsigned int rng;   // per-world RNG so worlds don't share rand() state
+    int blastQueue[MAX_BLAST_QUEUE];
+
+    WorldEvent events[MAX_WORLD_EVENTS];
+    int eventCount;
+};
+
+World g_world;  // the game shown in the window
+World g_attract;            // the autopilot's demo game behind the menu
+bool attractMode = false;   // --attract: keeps the tick loop and the pool busy on the menu
+bool attractLive = false;   // g_attract has a game going
+bool assistMode = false;    // --assist: the autopilot plays while the hand is idle
 
-    // title
-    glColor3f(1,1,1);
-    drawText(-0.12f, 0.22f, "Instructions");
+// Window
+int g_winW = 900, g_winH = 700;
 
-    // instructions text
-    drawText(-0.25f, 0.12f, "• Mouse to move paddle");
-    drawText(-0.25f, 0.05f, "• A / D or Arrow Keys to move");
-    drawText(-0.25f, -0.02f, "• SPACE to launch the ball");
-    drawText(-0.25f, -0.09f, "• P to pause/resume");
-    drawText(-0.25f, -0.16f, "• Esc to exit game");
+// Active animations (brick fades, brick flashes, screen shake).
+// Kept in a compact list so update/draw cost is O(active), not O(bricks).
+enum AnimKind { ANIM_BRICK_FADE, ANIM_FLASH, ANIM_SHAKE };
+struct Anim
+{
+    AnimKind kind;
+    int row, col;       // brick cell for ANIM_BRICK_FADE and ANIM_FLASH
+    float t;            // 1 -> 0 as the animation runs
+    float rate;         // t lost per second
+};
+#define MAX_ANIMS 128
+Anim anims[MAX_ANIMS];
+int animCount = 0;
+int lastAnimTickMs = 0;
+
+// Text queued by the shader pipeline until the geometry under it is drawn
+bool queueText(float x, float y, const char* text);
+
+// The score log's record of the game in progress
+void beginSession(const World& w, unsigned int seed);
+void endSession(const World& w);
+
+// Sizes the draw's scratch buffers for a level before it is played
+void reserveFrameBuffers(const BrickStore& bs);
+
+// The autopilot: the attract demo behind the menu and the --assist hand
+void reserveAutopilot(const World& w);
+void stepAttract(int now);
+void assistTick(World& w, int now);
+
+// Monotonic clock in microseconds, for timing and benchmarks
+double nowUs()
+{
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-    drawText(-0.25f, -0.28f, "Click anywhere to return to menu");
+// Utility text
+void drawText(float x, float y, const char* text)
+{
+    if (queueText(x, y, text)) return;
+    glRasterPos2f(x, y);
+    for (const char* c = text; *c != '\0'; ++c)
+        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
 }
 
-// Gradient background
-void drawBackground()
+// -------------------------- Metrics --------------------------
+// Counters and histograms for production monitoring. Every thread that records
+// gets its own shard on first use and is the only writer to it, so recording
+// is a relaxed load and store with no lock or locked instruction. Readers sum
+// the shards when asked. Histograms are log-linear like HdrHistogram: exact
+// below HIST_SUB, then HIST_SUB sub-buckets per power of two (12.5% wide).
+// --metrics-port serves the totals in Prometheus text format on 127.0.0.1,
+// --metrics-file rewrites a file with them once a second.
+enum CounterId
 {
-    glBegin(GL_QUADS);
-    // top-left (slightly bluish)
-    glColor3f(0.02f, 0.03f, 0.12f);
-    glVertex2f(-1.0f,  1.0f);
-    // top-right
-    glColor3f(0.07f, 0.05f, 0.2f);
-    glVertex2f( 1.0f,  1.0f);
-    // bottom-right (darker)
-    glColor3f(0.01f, 0.01f, 0.05f);
-    glVertex2f( 1.0f, -1.0f);
-    // bottom-left
-    glColor3f(0.01f, 0.01f, 0.05f);
-    glVertex2f(-1.0f, -1.0f);
-    glEnd();
+    M_TICKS, M_FRAMES, M_POWERUPS_SPAWNED, M_POWERUPS_COLLECTED, M_LIVES_LOST,
+    M_SCORE_COMMITS,
+    M_ENTER_STATE,                          // one per GameState from here
+    COUNTER_COUNT = M_ENTER_STATE + STATE_WIN + 1
+};
 
-    // subtle stars (random seed stable by frame)
-    int t = glutGet(GLUT_ELAPSED_TIME) / 700;
-    srand(t);
-    glPointSize(1.5f);
-    glBegin(GL_POINTS);
-    for (int i=0; i<30; i++)
+enum HistId
+{
+    H_FRAME_US, H_COLLISIONS_PER_TICK, H_AUDIO_BLOCK_US, H_LATCH_PX, H_LATCH_GAIN_US,
+    H_AUTOPILOT_US, H_AUTOPILOT_ROLLOUTS, H_PRESENT_JITTER_US, H_FRAMES_QUEUED,
+    HIST_COUNT
+};
+
+#define HIST_SUB_BITS 3
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((32 - HIST_SUB_BITS + 1) * HIST_SUB)
+#define HIST_EXPORT_BITS 20                 // exported le bounds: 2^k - 1 up to k = 20
+#define MAX_METRIC_SHARDS 16
+
+struct alignas(64) MetricShard
+{
+    std::atomic<unsigned long long> counters[COUNTER_COUNT];
+    std::atomic<unsigned long long> sums[HIST_COUNT];
+    std::atomic<unsigned long long> buckets[HIST_COUNT][HIST_BUCKETS];
+};
+MetricShard metricShards[MAX_METRIC_SHARDS];
+std::atomic<int> metricShardCount(0);
+thread_local MetricShard* threadShard = NULL;
+
+// Threads past the limit share the last shard and may lose the odd count there
+MetricShard* metricShard()
+{
+    if (!threadShard)
     {
-        float sx = (rand()%200 - 100)/100.0f;
-        float sy = (rand()%140 - 70)/100.0f;
-        float alpha = 0.4f + (rand()%60)/150.0f;
-        glColor4f(0.9f, 0.9f, 1.0f, alpha);
-        glVertex2f(sx, sy);
+        int i = metricShardCount.fetch_add(1);
+        threadShard = &metricShards[i < MAX_METRIC_SHARDS ? i : MAX_METRIC_SHARDS - 1];
     }
-    glEnd();
+    return threadShard;
 }
 
-// Paddle with gradient/shading
-void drawPaddle()
+inline void bumpMetric(std::atomic<unsigned long long>& a, unsigned long long n)
 {
-    // center colors vary a bit over time for subtle liveliness
-    float t = glutGet(GLUT_ELAPSED_TIME)/1000.0f;
-    float pulse = 0.05f * sinf(t*2.0f);
+    a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
 
-    // top gradient
-    glBegin(GL_QUADS);
-    glColor3f(0.12f + pulse, 0.45f + pulse, 0.95f); // top-left
-    glVertex2f(paddleX - paddleWidth/2, -0.95f + paddleHeight);
-    glColor3f(0.02f + pulse, 0.25f + pulse, 0.7f);  // top-right
-    glVertex2f(paddleX + paddleWidth/2, -0.95f + paddleHeight);
-    glColor3f(0.0f, 0.12f, 0.3f);                    // bottom-right
-    glVertex2f(paddleX + paddleWidth/2, -0.95f);
-    glColor3f(0.05f, 0.2f, 0.6f);                    // bottom-left
-    glVertex2f(paddleX - paddleWidth/2, -0.95f);
-    glEnd();
+inline void countMetric(CounterId c, unsigned long long n = 1)
+{
+    bumpMetric(metricShard()->counters[c], n);
+}
 
-    // small bevel lines
-    glColor3f(0,0,0);
-    glLineWidth(1.0f);
-    glBegin(GL_LINE_LOOP);
-    glVertex2f(paddleX - paddleWidth/2, -0.95f + paddleHeight);
-    glVertex2f(paddleX + paddleWidth/2, -0.95f + paddleHeight);
-    glVertex2f(paddleX + paddleWidth/2, -0.95f);
-    glVertex2f(paddleX - paddleWidth/2, -0.95f);
-    glEnd();
+inline int histBucket(unsigned int v)
+{
+    if (v < HIST_SUB) return (int)v;
+    int e = 31 - __builtin_clz(v);
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + (int)((v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
 }
 
-// Ball glow (soft layered circles)
-void drawBallGlow()
+// Largest value that lands in bucket i
+unsigned long long histBucketMax(int i)
 {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    for (int i = 5; i >= 1; --i)
+    if (i < HIST_SUB) return (unsigned long long)i;
+    int e = i / HIST_SUB + HIST_SUB_BITS - 1;
+    unsigned long long lower = (unsigned long long)(HIST_SUB + i % HIST_SUB) << (e - HIST_SUB_BITS);
+    return lower + (1ull << (e - HIST_SUB_BITS)) - 1;
+}
+
+inline void histRecord(HistId h, unsigned int v)
+{
+    MetricShard* s = metricShard();
+    bumpMetric(s->buckets[h][histBucket(v)], 1);
+    bumpMetric(s->sums[h], v);
+}
+
+struct MetricTotals
+{
+    unsigned long long counters[COUNTER_COUNT];
+    unsigned long long sums[HIST_COUNT];
+    unsigned long long buckets[HIST_COUNT][HIST_BUCKETS];
+};
+
+void readMetrics(MetricTotals& t)
+{
+    memset(&t, 0, sizeof(t));
+    int n = metricShardCount.load();
+    if (n > MAX_METRIC_SHARDS) n = MAX_METRIC_SHARDS;
+    for (int k = 0; k < n; ++k)
     {
-        float a = 0.06f + 0.02f * i;
-        float r = ballRadius + 0.004f*i;
-        glColor4f(1.0f, 0.3f, 0.3f, a);
-        glBegin(GL_TRIANGLE_FAN);
-        glVertex2f(ballX, ballY);
-        for (int a_deg = 0; a_deg <= 360; a_deg += 12)
+        const MetricShard& s = metricShards[k];
+        for (int c = 0; c < COUNTER_COUNT; ++c) t.counters[c] += s.counters[c].load(std::memory_order_relaxed);
+        for (int h = 0; h < HIST_COUNT; ++h)
         {
-            float ang = a_deg * (3.1415926f / 180.0f);
-            glVertex2f(ballX + r * cosf(ang), ballY + r * sinf(ang));
+            t.sums[h] += s.sums[h].load(std::memory_order_relaxed);
+            for (int i = 0; i < HIST_BUCKETS; ++i) t.buckets[h][i] += s.buckets[h][i].load(std::memory_order_relaxed);
         }
-        glEnd();
     }
-    glDisable(GL_BLEND);
 }
 
-// Ball core
-void drawBallCore()
+// Upper bound of the bucket holding quantile q
+unsigned long long histQuantile(const unsigned long long* buckets, double q)
 {
-    glColor3f(1.0f, 0.7f, 0.7f);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(ballX, ballY);
-    for (int a_deg = 0; a_deg <= 360; a_deg += 10)
+    unsigned long long total = 0, seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; ++i) total += buckets[i];
+    if (total == 0) return 0;
+    unsigned long long rank = (unsigned long long)(q * (total - 1)) + 1;
+    for (int i = 0; i < HIST_BUCKETS; ++i)
     {
-        float ang = a_deg * (3.1415926f / 180.0f);
-        glVertex2f(ballX + ballRadius * cosf(ang), ballY + ballRadius * sinf(ang));
+        seen += buckets[i];
+        if (seen >= rank) return histBucketMax(i);
     }
-    glEnd();
+    return histBucketMax(HIST_BUCKETS - 1);
 }
 
-// Ball trail: draw faded circles at last positions
-void drawBallTrail()
+struct MetricInfo
 {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    for (int i = 0; i < TRAIL_LEN; ++i)
+    const char* name;
+    const char* help;
+    const char* label;      // counters only; NULL = none
+};
+
+const MetricInfo counterInfo[COUNTER_COUNT] =
+{
+    { "dxball_ticks_total", "Simulation ticks stepped.", NULL },
+    { "dxball_frames_total", "Frames rendered.", NULL },
+    { "dxball_powerups_spawned_total", "Power-ups dropped from bricks.", NULL },
+    { "dxball_powerups_collected_total", "Power-ups caught by the paddle.", NULL },
+    { "dxball_lives_lost_total", "Balls lost.", NULL },
+    { "dxball_score_commits_total", "Score log batches flushed to disk.", NULL },
+    { "dxball_state_transitions_total", "Game state changes by new state.", "to=\"menu\"" },
+    { "dxball_state_transitions_total", "", "to=\"instructions\"" },
+    { "dxball_state_transitions_total", "", "to=\"playing\"" },
+    { "dxball_state_transitions_total", "", "to=\"paused\"" },
+    { "dxball_state_transitions_total", "", "to=\"gameover\"" },
+    { "dxball_state_transitions_total", "", "to=\"win\"" },
+};
+
+const MetricInfo histInfo[HIST_COUNT] =
+{
+    { "dxball_frame_time_us", "CPU time to build and submit a frame, microseconds.", NULL },
+    { "dxball_collisions_per_tick", "Paddle and brick contacts per simulation tick.", NULL },
+    { "dxball_audio_block_us", "Mixer time per 10 ms audio block, microseconds.", NULL },
+    { "dxball_paddle_latch_px", "Distance from the simulated paddle to where it was drawn, pixels.", NULL },
+    { "dxball_paddle_latch_gain_us", "How much newer the drawn paddle's pointer sample was than the simulation's, microseconds.", NULL },
+    { "dxball_autopilot_plan_us", "Autopilot planning time per decision, microseconds.", NULL },
+    { "dxball_autopilot_rollouts", "Rollouts played per autopilot decision.", NULL },
+    { "dxball_present_jitter_us", "Distance of each present-to-present interval from the refresh period, microseconds.", NULL },
+    { "dxball_frames_queued", "Frames still in flight right after a swap, with --frames-in-flight.", NULL },
+};
+
+void appendf(std::string& out, const char* fmt, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n > 0) out.append(line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
+}
+
+// Prometheus text exposition format 0.0.4
+void formatMetrics(std::string& out)
+{
+    static MetricTotals t;      // exporter thread only
+    readMetrics(t);
+    out.clear();
+    for (int c = 0; c < COUNTER_COUNT; ++c)
     {
-        float alpha = 0.10f * (1.0f - (float)i / TRAIL_LEN);
-        float r = ballRadius * (1.0f - 0.07f * i);
-        glColor4f(1.0f, 0.4f, 0.4f, alpha);
-        glBegin(GL_TRIANGLE_FAN);
-        glVertex2f(trailX[i], trailY[i]);
-        for (int a_deg = 0; a_deg <= 360; a_deg += 18)
+        const MetricInfo& m = counterInfo[c];
+        if (c == 0 || strcmp(m.name, counterInfo[c - 1].name))
+            appendf(out, "# HELP %s %s\n# TYPE %s counter\n", m.name, m.help, m.name);
+        if (m.label) appendf(out, "%s{%s} %llu\n", m.name, m.label, t.counters[c]);
+        else appendf(out, "%s %llu\n", m.name, t.counters[c]);
+    }
+    for (int h = 0; h < HIST_COUNT; ++h)
+    {
+        const char* name = histInfo[h].name;
+        appendf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, histInfo[h].help, name);
+        unsigned long long cum = 0;
+        int i = 0;
+        for (int k = 0; k <= HIST_EXPORT_BITS; ++k)
         {
-            float ang = a_deg * (3.1415926f / 180.0f);
-            glVertex2f(trailX[i] + r * cosf(ang), trailY[i] + r * sinf(ang));
+            unsigned long long le = (1ull << k) - 1;
+            for (; i < HIST_BUCKETS && histBucketMax(i) <= le; ++i) cum += t.buckets[h][i];
+            appendf(out, "%s_bucket{le=\"%llu\"} %llu\n", name, le, cum);
         }
-        glEnd();
+        for (; i < HIST_BUCKETS; ++i) cum += t.buckets[h][i];
+        appendf(out, "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %llu\n%s_count %llu\n",
+                name, cum, name, t.sums[h], name, cum);
+        appendf(out, "# HELP %s_quantile %s\n# TYPE %s_quantile gauge\n", name, "Quantiles from the fine buckets.", name);
+        static const double qs[3] = { 0.5, 0.99, 0.999 };
+        for (int q = 0; q < 3; ++q)
+            appendf(out, "%s_quantile{quantile=\"%g\"} %llu\n", name, qs[q], histQuantile(t.buckets[h], qs[q]));
     }
-    glDisable(GL_BLEND);
 }
 
-// Draw bricks - normal and fading-removed with animation
-void drawBricks()
+// Exporter thread: answers scrapes on the socket and rewrites the file
+#ifdef _WIN32
+typedef SOCKET MetricSocket;
+#define BAD_METRIC_SOCKET INVALID_SOCKET
+#define closeMetricSocket closesocket
+#else
+typedef int MetricSocket;
+#define BAD_METRIC_SOCKET (-1)
+#define closeMetricSocket close
+#endif
+#define METRICS_FILE_PERIOD_MS 1000
+#define METRICS_CLIENT_TIMEOUT_MS 250   // a scraper that stalls longer is dropped
+
+struct MetricsExporter
+{
+    MetricSocket listener;
+    char filePath[260];
+    std::atomic<bool> running;
+    std::thread thread;
+    std::string text;
+};
+MetricsExporter g_exporter;
+bool metricsExporting = false;
+
+MetricSocket openMetricsSocket(int port)
 {
-    for (int i=0; i<ROWS; ++i)
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return BAD_METRIC_SOCKET;
+#endif
+    MetricSocket s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == BAD_METRIC_SOCKET) return s;
+    int yes = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);  // local scrapes only
+    if (bind(s, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(s, 4) != 0)
     {
-        for (int j=0; j<COLS; ++j)
-        {
-            float x = brickStartX + j * (brickWidth + brickSpacingX);
-            float y = brickStartY - i * (brickHeight + brickSpacingY);
+        closeMetricSocket(s);
+        return BAD_METRIC_SOCKET;
+    }
+    return s;
+}
 
-            if (bricks[i][j])
-            {
-                // main brick body with slight vertical gradient
-                glBegin(GL_QUADS);
-                glColor3f(0.9f, 0.4f - i*0.06f, 0.2f + j*0.03f);
-                glVertex2f(x, y);
-                glColor3f(0.7f, 0.25f - i*0.04f, 0.15f + j*0.02f);
-                glVertex2f(x + brickWidth, y);
-                glColor3f(0.5f, 0.12f - i*0.02f, 0.10f + j*0.01f);
-                glVertex2f(x + brickWidth, y - brickHeight);
-                glColor3f(0.65f, 0.20f - i*0.03f, 0.12f + j*0.015f);
-                glVertex2f(x, y - brickHeight);
-                glEnd();
-                // border
-                glColor3f(0.08f, 0.06f, 0.04f);
-                glLineWidth(1.5f);
-                glBegin(GL_LINE_LOOP);
-                glVertex2f(x, y);
-                glVertex2f(x + brickWidth, y);
-                glVertex2f(x + brickWidth, y - brickHeight);
-                glVertex2f(x, y - brickHeight);
-                glEnd();
-            }
-            // draw fading remnants if any
-            if (brickFade[i][j] > 0.001f)
-            {
-                float f = brickFade[i][j];
-                glEnable(GL_BLEND);
-                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-                glColor4f(1.0f, 0.6f - i*0.05f, 0.25f + j*0.02f, f);
-                // simple expanding square fade
-                float inset = (1.0f - f) * 0.06f;
-                glBegin(GL_QUADS);
-                glVertex2f(x - inset, y + inset);
-                glVertex2f(x + brickWidth + inset, y + inset);
-                glVertex2f(x + brickWidth + inset, y - brickHeight - inset);
-                glVertex2f(x - inset, y - brickHeight - inset);
-                glEnd();
-                glDisable(GL_BLEND);
-            }
-        }
+// Bound how long recv and send on a scrape connection can block, so a client
+// that connects and goes quiet can't hold up the exporter thread
+void setMetricTimeouts(MetricSocket s, int ms)
+{
+#ifdef _WIN32
+    DWORD t = (DWORD)ms;
+#else
+    struct timeval t = { ms / 1000, (ms % 1000) * 1000 };
+#endif
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&t, sizeof(t));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&t, sizeof(t));
+}
+
+// One scrape: read the request head, answer with the current totals, close.
+// A client that sends nothing in time is closed without an answer.
+void serveMetrics(MetricsExporter& e)
+{
+    MetricSocket c = accept(e.listener, NULL, NULL);
+    if (c == BAD_METRIC_SOCKET) return;
+    setMetricTimeouts(c, METRICS_CLIENT_TIMEOUT_MS);
+    char request[1024];
+    if (recv(c, request, sizeof(request), 0) <= 0)
+    {
+        closeMetricSocket(c);
+        return;
     }
+    formatMetrics(e.text);
+    char head[160];
+    int n = snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %u\r\nConnection: close\r\n\r\n", (unsigned int)e.text.size());
+    send(c, head, n, 0);
+    send(c, e.text.data(), (int)e.text.size(), 0);
+    closeMetricSocket(c);
 }
 
-// Power-ups draw with pulse animation
-void drawPowerUps()
+// Written to a temporary name and renamed, so readers never see half a file
+void writeMetricsFile(MetricsExporter& e)
 {
-    int now = glutGet(GLUT_ELAPSED_TIME);
-    for (int i = 0; i < ROWS*COLS; ++i)
+    char tmp[270];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", e.filePath);
+    FILE* f = fopen(tmp, "wb");
+    if (!f) return;
+    formatMetrics(e.text);
+    fwrite(e.text.data(), 1, e.text.size(), f);
+    fclose(f);
+#ifdef _WIN32
+    MoveFileExA(tmp, e.filePath, MOVEFILE_REPLACE_EXISTING);
+#else
+    rename(tmp, e.filePath);
+#endif
+}
+
+void exporterMain(MetricsExporter* e)
+{
+    double nextFileUs = nowUs();
+    while (e->running.load(std::memory_order_acquire))
     {
-        if (!powerUps[i].visible) continue;
-        float s = 0.02f * (1.0f + 0.15f * sinf(now/250.0f + i));
-        switch (powerUps[i].type)
+        if (e->filePath[0] && nowUs() >= nextFileUs)
         {
-        case POWER_EXTRA_LIFE:
-            glColor3f(0.2f, 1.0f, 0.2f);
-            break;
-        case POWER_FASTER_BALL:
-            glColor3f(1.0f, 0.6f, 0.6f);
-            break;
-        case POWER_WIDER_PADDLE:
-            glColor3f(0.6f, 0.8f, 1.0f);
-            break;
+            writeMetricsFile(*e);
+            nextFileUs += METRICS_FILE_PERIOD_MS * 1000.0;
+        }
+        if (e->listener == BAD_METRIC_SOCKET)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
         }
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glBegin(GL_QUADS);
-        glVertex2f(powerUps[i].x - 0.03f - s, powerUps[i].y + s);
-        glVertex2f(powerUps[i].x + 0.03f + s, powerUps[i].y + s);
-        glVertex2f(powerUps[i].x + 0.03f + s, powerUps[i].y - 0.05f - s);
-        glVertex2f(powerUps[i].x - 0.03f - s, powerUps[i].y - 0.05f - s);
-        glEnd();
-        glDisable(GL_BLEND);
+        // wake at least every 100 ms to notice a stop
+        fd_set ready;
+        FD_ZERO(&ready);
+        FD_SET(e->listener, &ready);
+        struct timeval tv = { 0, 100000 };
+        if (select((int)e->listener + 1, &ready, NULL, NULL, &tv) > 0) serveMetrics(*e);
+    }
+}
 
-        // label
-        char label = 'L';
-        if (powerUps[i].type == POWER_FASTER_BALL) label = 'F';
-        if (powerUps[i].type == POWER_WIDER_PADDLE) label = 'W';
-        glColor3f(0,0,0);
-        char str[2] = {label, 0};
-        glRasterPos2f(powerUps[i].x - 0.01f, powerUps[i].y - 0.03f);
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, str[0]);
+bool startMetrics(int port, const char* path)
+{
+    g_exporter.listener = BAD_METRIC_SOCKET;
+    g_exporter.filePath[0] = '\0';
+    if (port > 0)
+    {
+        g_exporter.listener = openMetricsSocket(port);
+        if (g_exporter.listener == BAD_METRIC_SOCKET) printf("metrics: cannot listen on 127.0.0.1:%d\n", port);
     }
+    if (path) snprintf(g_exporter.filePath, sizeof(g_exporter.filePath), "%s", path);
+    if (g_exporter.listener == BAD_METRIC_SOCKET && !g_exporter.filePath[0]) return false;
+    g_exporter.running.store(true);
+    g_exporter.thread = std::thread(exporterMain, &g_exporter);
+    metricsExporting = true;
+    return true;
 }
 
-// HUD drawing
-void drawHUD()
+void stopMetrics()
 {
-    char buffer[64];
-    sprintf(buffer, "Score: %d", score);
-    drawText(-0.95f, 0.93f, buffer);
+    if (!metricsExporting) return;
+    metricsExporting = false;
+    g_exporter.running.store(false);
+    g_exporter.thread.join();
+    if (g_exporter.listener != BAD_METRIC_SOCKET) closeMetricSocket(g_exporter.listener);
+    if (g_exporter.filePath[0]) writeMetricsFile(g_exporter);   // final totals
+}
 
-    sprintf(buffer, "Lives: %d", lives);
-    drawText(0.75f, 0.93f, buffer);
+// -------------------------- Brick layout helper --------------------------
+struct BoardLayout
+{
+    float w, h;             // brick size
+    float pitchX, pitchY;   // distance between neighbouring cells
+    float invPitchX, invPitchY;
+    float startX, startY;   // top-left corner of cell (0,0)
+    float ceilY;            // top wall
+};
+
+// Tall boards are shrunk to fit down to this fraction of their full-width size;
+// past that they keep the size and extend upwards, and the camera scrolls
+#define TALL_MIN_SCALE 0.5f
+
+// The standard 5x8 board keeps its original size; other boards are scaled to the
+// same width, and shrunk further if they would reach down into the paddle area.
+// constexpr so the same numbers can be baked into per-shape tables below.
+constexpr BoardLayout boardLayout(int rows, int cols)
+{
+    float marginY = 0.10f; // top margin
+    float maxH = 1.0f;     // tallest board that fits above the ball
 
-    int elapsedMs = 0;
-    if (state == STATE_PLAYING || state == STATE_PAUSED)
+    float stdW = COLS * brickWidth + (COLS - 1) * brickSpacingX;
+    float k = stdW / (cols * (brickWidth + brickSpacingX) - brickSpacingX);
+    float totalH = k * (rows * (brickHeight + brickSpacingY) - brickSpacingY);
+    if (totalH > maxH)
     {
-        int now = glutGet(GLUT_ELAPSED_TIME);
-        elapsedMs = now - gameStartTimeMs - totalPausedMs;
+        float fit = maxH / totalH;
+        if (fit < TALL_MIN_SCALE) fit = TALL_MIN_SCALE;
+        k *= fit;
+        totalH *= fit;
     }
-    int seconds = elapsedMs / 1000;
-    sprintf(buffer, "Time: %02d:%02d", seconds / 60, seconds % 60);
-    drawText(-0.1f, 0.93f, buffer);
 
-    // -------------- MENU SCREEN --------------
-    if (state == STATE_MENU)
-    {
-        drawText(-0.25f, 0.45f, "🎮 WELCOME TO DX-BALL 🎮");
-        drawText(-0.15f, 0.25f, "Click anywhere to start");
+    BoardLayout L = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    L.w = brickWidth * k;
+    L.h = brickHeight * k;
+    L.pitchX = (brickWidth + brickSpacingX) * k;
+    L.pitchY = (brickHeight + brickSpacingY) * k;
+    L.invPitchX = 1.0f / L.pitchX;
+    L.invPitchY = 1.0f / L.pitchY;
 
-        drawText(-0.25f, 0.05f, "Controls:");
-        drawText(-0.18f, -0.05f, "• Mouse to move paddle");
-        drawText(-0.18f, -0.12f, "• A / D or Arrow Keys to move");
-        drawText(-0.18f, -0.19f, "• SPACE to launch the ball");
-        drawText(-0.18f, -0.26f, "• P to pause/resume");
-        drawText(-0.18f, -0.33f, "• Esc to exit game");
-    }
+    float totalW = cols * L.pitchX - brickSpacingX * k;
+    L.startX = -totalW * 0.5f;
 
-    // -------------- PAUSED SCREEN --------------
-    if (state == STATE_PAUSED)
-    {
-        drawText(-0.15f, 0.1f, "⏸ GAME PAUSED ⏸");
-        drawText(-0.25f, -0.05f, "• Press P or click to resume");
-        drawText(-0.25f, -0.12f, "• Press Esc to quit to menu");
-    }
+    L.startY = 1.0f - marginY;
+    L.startY -= (brickHeight * 0.5f);
 
-    // -------------- GAME OVER SCREEN --------------
-    if (state == STATE_GAMEOVER)
-    {
-        drawText(-0.25f, 0.2f, "💀 GAME OVER 💀");
-        sprintf(buffer, "Final Score: %d", score);
-        drawText(-0.18f, 0.05f, buffer);
-        drawText(-0.22f, -0.1f, "• Click to restart");
-        drawText(-0.22f, -0.18f, "• Press Esc to exit");
-    }
+    // extra downward shift
+    L.startY -= 0.05f;
 
-    // -------------- WIN SCREEN --------------
-    if (state == STATE_WIN)
-    {
-        drawText(-0.25f, 0.2f, "🏆 YOU WIN! 🏆");
-        sprintf(buffer, "Final Score: %d", score);
-        drawText(-0.18f, 0.05f, buffer);
-        drawText(-0.22f, -0.1f, "• Click to play again");
-        drawText(-0.22f, -0.18f, "• Press Esc to exit");
-    }
+    // whatever doesn't fit goes above the screen, with the same margin on top
+    float over = totalH > maxH ? totalH - maxH : 0.0f;
+    L.startY += over;
+    L.ceilY = 1.0f + over;
+    return L;
 }
-// Main Menu overlay with buttons
-void drawMenuScreenOverlay()
+
+void computeBrickLayout(BrickStore& bs)
 {
-    // dim entire screen
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glColor4f(0, 0, 0, 0.6f);
-    glBegin(GL_QUADS);
-    glVertex2f(-1, -1);
-    glVertex2f(1, -1);
-    glVertex2f(1, 1);
-    glVertex2f(-1, 1);
-    glEnd();
-    glDisable(GL_BLEND);
+    BoardLayout L = boardLayout(bs.rows, bs.cols);
+    bs.w = L.w;
+    bs.h = L.h;
+    bs.pitchX = L.pitchX;
+    bs.pitchY = L.pitchY;
+    bs.invPitchX = L.invPitchX;
+    bs.invPitchY = L.invPitchY;
+    bs.startX = L.startX;
+    bs.startY = L.startY;
+    bs.ceilY = L.ceilY;
+}
 
-    // center panel
-    float panelW = 0.7f, panelH = 0.6f;
-    glColor3f(0.1f, 0.1f, 0.15f);
-    glBegin(GL_QUADS);
-    glVertex2f(-panelW/2,  panelH/2);
-    glVertex2f( panelW/2,  panelH/2);
-    glVertex2f( panelW/2, -panelH/2);
-    glVertex2f(-panelW/2, -panelH/2);
-    glEnd();
-
-    // title
-    glColor3f(1, 1, 1);
-    drawText(-0.20f, 0.22f, "DX-Ball OpenGL");
-
-    // example menu buttons (3 items)
-    Button menuButtons[3];
-    menuButtons[0] = { -0.25f, 0.25f, 0.10f,  0.00f,  "Start Game" };
-    menuButtons[1] = { -0.25f, 0.25f, -0.05f, -0.15f, "Instructions" };
-    menuButtons[2] = { -0.25f, 0.25f, -0.20f, -0.30f, "Quit" };
-
-    for (int i=0; i<3; i++)
-    {
-        Button b = menuButtons[i];
-        // button bg
-        glColor3f(0.18f, 0.18f, 0.22f);
-        glBegin(GL_QUADS);
-        glVertex2f(b.left, b.top);
-        glVertex2f(b.right, b.top);
-        glVertex2f(b.right, b.bottom);
-        glVertex2f(b.left, b.bottom);
-        glEnd();
-        // border
-        glColor3f(0.9f, 0.9f, 0.9f);
-        glLineWidth(1.0f);
-        glBegin(GL_LINE_LOOP);
-        glVertex2f(b.left, b.top);
-        glVertex2f(b.right, b.top);
-        glVertex2f(b.right, b.bottom);
-        glVertex2f(b.left, b.bottom);
-        glEnd();
-        // label centered
-        float tx = (b.left + b.right) * 0.5f - 0.09f;
-        float ty = (b.top + b.bottom) * 0.5f - 0.02f;
-        drawText(tx, ty, b.label);
-    }
+// -------------------------- Board specialisation --------------------------
+// The brick loops (collision, drawing) are written once against a geometry
+// policy. RuntimeBoard reads the layout stored in the BrickStore and covers any
+// level. FixedBoard<R, C> answers from constexpr coordinate tables, with loop
+// trip counts known at compile time and the loops expanded by Unroll.
+// Shapes listed in STANDARD_BOARDS get the fixed version.
+#define STANDARD_BOARDS(X) X(5, 8) X(10, 16)
+
+// floorf without the libm call; fine for the small ranges used here
+inline int fastFloor(float v)
+{
+    int i = (int)v;
+    return i - (v < (float)i);
 }
 
-// Game Over screen overlay with larger panel and centered text
-void drawGameOverScreenOverlay()
+// Rows of the board that overlap the band bottom..top, widened by margin;
+// i0 > i1 when none do
+void visibleRows(const BrickStore& bs, float bottom, float top, float margin, int* i0, int* i1)
 {
-    // Dim background
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glColor4f(0, 0, 0, 0.6f);
-    glBegin(GL_QUADS);
-        glVertex2f(-1, -1);
-        glVertex2f( 1, -1);
-        glVertex2f( 1,  1);
-        glVertex2f(-1,  1);
-    glEnd();
-    glDisable(GL_BLEND);
+    *i0 = std::max(0, fastFloor((bs.startY - bs.h - top - margin) * bs.invPitchY));
+    *i1 = std::min(bs.rows - 1, fastFloor((bs.startY - bottom + margin) * bs.invPitchY));
+}
 
-    // Larger Panel
-    float panelW = 0.75f; // increased width
-    float panelH = 0.6f;  // increased height
-    float panelX = 0.0f;
-    float panelY = 0.0f;
-
-    glColor3f(0.1f, 0.1f, 0.15f); // dark panel
-    glBegin(GL_QUADS);
-        glVertex2f(panelX - panelW/2, panelY + panelH/2);
-        glVertex2f(panelX + panelW/2, panelY + panelH/2);
-        glVertex2f(panelX + panelW/2, panelY - panelH/2);
-        glVertex2f(panelX - panelW/2, panelY - panelH/2);
-    glEnd();
-
-    // Border
-    glLineWidth(3.0f);
-    glColor3f(1.0f, 0.2f, 0.2f);
-    glBegin(GL_LINE_LOOP);
-        glVertex2f(panelX - panelW/2, panelY + panelH/2);
-        glVertex2f(panelX + panelW/2, panelY + panelH/2);
-        glVertex2f(panelX + panelW/2, panelY - panelH/2);
-        glVertex2f(panelX - panelW/2, panelY - panelH/2);
-    glEnd();
-
-    // Updated Y positions for larger panel
-    float titleY = 0.2f;
-    float scoreY = 0.08f;
-    float instr1Y = -0.08f;
-    float instr2Y = -0.18f;
-
-    // Title
-    glColor3f(1.0f, 0.2f, 0.2f); // red
-    drawText(-0.18f, titleY, "💀 GAME OVER 💀");
-
-    // Score
-    char buffer[32];
-    sprintf(buffer, "Final Score: %d", score);
-    glColor3f(1.0f, 1.0f, 1.0f); // white
-    drawText(-0.12f, scoreY, buffer);
-
-    // Instructions
-    glColor3f(0.8f, 0.8f, 0.8f); // light gray
-    drawText(-0.25f, instr1Y, "Click LEFT MOUSE to RESTART");
-    drawText(-0.15f, instr2Y, "Press ESC to QUIT");
-}
-
-// Pause menu overlay with buttons
-void drawPauseMenuOverlay()
-{
-    // dim entire screen
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glColor4f(0,0,0,0.6f);
-    glBegin(GL_QUADS);
-    glVertex2f(-1,-1);
-    glVertex2f(1,-1);
-    glVertex2f(1,1);
-    glVertex2f(-1,1);
-    glEnd();
-    glDisable(GL_BLEND);
+// Calls f(K), f(K+1) .. f(N-1), expanded at compile time
+template <int K, int N>
+struct Unroll
+{
+    template <class F> static inline void run(F& f)
+    {
+        f(K);
+        Unroll<K + 1, N>::run(f);
+    }
+};
+template <int N>
+struct Unroll<N, N>
+{
+    template <class F> static inline void run(F&) {}
+};
 
-    // center panel
-    float panelW = 0.6f, panelH = 0.5f;
-    glColor3f(0.08f, 0.08f, 0.12f);
-    glBegin(GL_QUADS);
-    glVertex2f(-panelW/2,  panelH/2);
-    glVertex2f( panelW/2,  panelH/2);
-    glVertex2f( panelW/2, -panelH/2);
-    glVertex2f(-panelW/2, -panelH/2);
-    glEnd();
-
-    // title
-    glColor3f(1,1,1);
-    drawText(-0.12f, 0.18f, "Game Paused");
-
-    // draw buttons
-    for (int i=0; i<3; i++)
-    {
-        Button b = pauseButtons[i];
-        // button bg
-        glColor3f(0.18f, 0.18f, 0.22f);
-        glBegin(GL_QUADS);
-        glVertex2f(b.left, b.top);
-        glVertex2f(b.right, b.top);
-        glVertex2f(b.right, b.bottom);
-        glVertex2f(b.left, b.bottom);
-        glEnd();
-        // border
-        glColor3f(0.9f, 0.9f, 0.9f);
-        glLineWidth(1.0f);
-        glBegin(GL_LINE_LOOP);
-        glVertex2f(b.left, b.top);
-        glVertex2f(b.right, b.top);
-        glVertex2f(b.right, b.bottom);
-        glVertex2f(b.left, b.bottom);
-        glEnd();
-        // label
-        float tx = (b.left + b.right) * 0.5f - 0.10f;
-        float ty = (b.top + b.bottom) * 0.5f - 0.02f;
-        drawText(tx, ty, b.label);
+template <int R, int C>
+struct BoardTables
+{
+    BoardLayout L;
+    float colX[C];
+    float rowY[R];
+    constexpr BoardTables() : L(boardLayout(R, C)), colX(), rowY()
+    {
+        for (int j = 0; j < C; ++j) colX[j] = L.startX + j * L.pitchX;
+        for (int i = 0; i < R; ++i) rowY[i] = L.startY - i * L.pitchY;
     }
-}
+};
+template <int R, int C>
+constexpr BoardTables<R, C> boardTables = BoardTables<R, C>();
 
-    // Fireworks (simple)
-void drawFireworks()
+struct RuntimeBoard
 {
-    if (state != STATE_WIN) return;
-    int now = glutGet(GLUT_ELAPSED_TIME);
-    srand(now / 90);
-    for (int k=0; k<25; k++)
+    const BrickStore& bs;
+    explicit RuntimeBoard(const BrickStore& b) : bs(b) {}
+    int rows() const { return bs.rows; }
+    int cols() const { return bs.cols; }
+    float brickW() const { return bs.w; }
+    float brickH() const { return bs.h; }
+    float startX() const { return bs.startX; }
+    float startY() const { return bs.startY; }
+    float invPitchX() const { return bs.invPitchX; }
+    float invPitchY() const { return bs.invPitchY; }
+    float colX(int j) const { return brickX(bs, j); }
+    float rowY(int i) const { return brickY(bs, i); }
+
+    template <class F> void forEachCell(F& f) const
     {
-        float x = (rand()%200 - 100)/100.0f;
-        float y = (rand()%140 - 20)/100.0f;
-        float r = rand()%256/255.0f, g = rand()%256/255.0f, b = rand()%256/255.0f;
-        glColor3f(r,g,b);
-        glBegin(GL_LINES);
-        glVertex2f(x, y);
-        glVertex2f(x + (rand()%40 - 20)/200.0f, y + (rand()%40 - 20)/200.0f);
-        glEnd();
+        for (int k = 0; k < bs.rows*bs.cols; ++k) f(k);
+    }
+    // cells of rows i0..i1 only
+    template <class F> void forEachCellInRows(int i0, int i1, F& f) const
+    {
+        for (int k = i0 * bs.cols; k < (i1 + 1) * bs.cols; ++k) f(k);
     }
+    template <class F> void forEachCandidate(int i0, int i1, int j0, int j1, F& f) const
+    {
+        for (int i = i0; i <= i1; i++)
+            for (int j = j0; j <= j1; j++)
+                f(i, j);
+    }
+};
+
+template <int R, int C>
+struct FixedBoard
+{
+    static constexpr int rows() { return R; }
+    static constexpr int cols() { return C; }
+    static constexpr float brickW() { return boardTables<R, C>.L.w; }
+    static constexpr float brickH() { return boardTables<R, C>.L.h; }
+    static constexpr float startX() { return boardTables<R, C>.L.startX; }
+    static constexpr float startY() { return boardTables<R, C>.L.startY; }
+    static constexpr float invPitchX() { return boardTables<R, C>.L.invPitchX; }
+    static constexpr float invPitchY() { return boardTables<R, C>.L.invPitchY; }
+    static constexpr float colX(int j) { return boardTables<R, C>.colX[j]; }
+    static constexpr float rowY(int i) { return boardTables<R, C>.rowY[i]; }
+
+    // most cells the ball's bounding box can touch along each axis
+    static constexpr int SPAN_X = (int)((2 * ballRadius + 0.01f) / boardLayout(R, C).pitchX) + 2;
+    static constexpr int SPAN_Y = (int)((2 * ballRadius + 0.01f) / boardLayout(R, C).pitchY) + 2;
+
+    template <class F> void forEachCell(F& f) const
+    {
+        Unroll<0, R*C>::run(f);
+    }
+    // fixed shapes fit on screen, so this is normally the whole board
+    template <class F> void forEachCellInRows(int i0, int i1, F& f) const
+    {
+        if (i0 == 0 && i1 == R - 1) forEachCell(f);
+        else for (int k = i0 * C; k < (i1 + 1) * C; ++k) f(k);
+    }
+    template <class F> void forEachCandidate(int i0, int i1, int j0, int j1, F& f) const
+    {
+        auto row = [&](int di)
+        {
+            int i = i0 + di;
+            if (i > i1) return;
+            auto col = [&](int dj)
+            {
+                if (j0 + dj <= j1) f(i, j0 + dj);
+            };
+            Unroll<0, SPAN_X>::run(col);
+        };
+        Unroll<0, SPAN_Y>::run(row);
+    }
+};
+
+// f(board) with the most specific geometry for this brick store
+template <class F>
+void withBoard(const BrickStore& bs, F f)
+{
+#define X(r, c) \
+    if (bs.rows == r && bs.cols == c) { f(FixedBoard<r, c>()); return; }
+    STANDARD_BOARDS(X)
+#undef X
+    f(RuntimeBoard(bs));
+}
+
+// -------------------------- Animations --------------------------
+void startAnim(AnimKind kind, int row, int col, float rate)
+{
+    if (animCount >= MAX_ANIMS) return; // drop cosmetic effect when full
+    Anim& a = anims[animCount++];
+    a.kind = kind;
+    a.row = row;
+    a.col = col;
+    a.t = 1.0f;
+    a.rate = rate;
+}
+
+void clearAnims()
+{
+    animCount = 0;
+}
+
+// Advance on wall-clock time so fades keep running after a life is lost;
+// frozen while paused.
+void updateAnims(int now)
+{
+    float dt = (now - lastAnimTickMs) / 1000.0f;
+    lastAnimTickMs = now;
+    if (state == STATE_PAUSED || dt <= 0.0f) return;
+    if (dt > 0.1f) dt = 0.1f;
+
+    int i = 0;
+    while (i < animCount)
+    {
+        anims[i].t -= anims[i].rate * dt;
+        if (anims[i].t <= 0.0f)
+            anims[i] = anims[--animCount]; // swap-remove, order doesn't matter
+        else
+            ++i;
+    }
+}
+
+// Screen shake offset from the strongest running shake
+void animShakeOffset(float* ox, float* oy)
+{
+    *ox = *oy = 0.0f;
+    float best = 0.0f;   // list order changes on every swap-remove, so pick by t
+    for (int i = 0; i < animCount; ++i)
+    {
+        if (anims[i].kind != ANIM_SHAKE || anims[i].t <= best) continue;
+        best = anims[i].t;
+        float amp = 0.02f * best;
+        *ox = amp * sinf(best * 90.0f);
+        *oy = amp * cosf(best * 70.0f);
+    }
+}
+
+// -------------------------- Camera --------------------------
+// Vertical scroll for boards taller than the screen. The view spans
+// cameraY-1..cameraY+1 and gameplay geometry is drawn shifted down by cameraY;
+// the HUD and overlays stay put. The camera only moves when the ball leaves a
+// band around the view centre, so on boards that fit it never leaves 0.
+#define CAMERA_BAND_LOW  -0.3f  // low enough to show the paddle as the ball comes down
+#define CAMERA_BAND_HIGH  0.5f
+float cameraY = 0.0f;
+
+void updateCamera(const World& w)
+{
+    float by = toF(w.ball.y);
+    if (by > cameraY + CAMERA_BAND_HIGH) cameraY = by - CAMERA_BAND_HIGH;
+    if (by < cameraY + CAMERA_BAND_LOW) cameraY = by - CAMERA_BAND_LOW;
+    cameraY = std::min(cameraY, w.bricks.ceilY - 1.0f);
+    cameraY = std::max(cameraY, 0.0f);
+}
+
+// Board rows the view can show; the margin covers screen shake
+void cameraRows(const BrickStore& bs, int* i0, int* i1)
+{
+    visibleRows(bs, cameraY - 1.0f, cameraY + 1.0f, 0.05f, i0, i1);
+}
+
+// -------------------------- Late-latched paddle --------------------------
+// The simulation takes the pointer once per tick, so the paddle the ball hits
+// is the same in every replay of that tick. The paddle on screen is latched as
+// late as possible instead: right before it is recorded the newest pointer
+// position is read (GetCursorPos on Windows; GLUT has no such query, so
+// elsewhere it is the latest motion event) and the paddle is drawn there. The
+// distance to the simulated paddle and how much newer the drawn sample is go to
+// the metrics.
+int pointerX = 0;               // window pixels, from the latest motion event
+double pointerUs = 0.0;         // when that event came in
+bool pointerPending = false;    // not yet taken by a tick
+bool pointerActive = false;     // the mouse, not the keyboard, moved the paddle last
+double simPointerUs = 0.0;      // sample time of the pointer the simulation has
+double handUs = 0.0;            // the player last moved the paddle, for --assist
+
+// Keyboard moves and new rounds hand the paddle back to the simulation
+void releasePointer()
+{
+    pointerActive = pointerPending = false;
+    simPointerUs = 0.0;
+}
+
+inline float pointerToWorld(int x)
+{
+    return (float)x / (float)g_winW * 2.0f - 1.0f;
+}
+
+// Newest pointer x in window pixels and when it was sampled
+void readPointer(int* x, double* us)
+{
+#ifdef _WIN32
+    POINT p;
+    HWND wnd = WindowFromDC(wglGetCurrentDC());
+    if (wnd && GetCursorPos(&p) && ScreenToClient(wnd, &p))
+    {
+        *x = p.x;
+        *us = nowUs();
+        return;
+    }
+#endif
+    *x = pointerX;
+    *us = pointerUs;
+}
+
+// Where to draw the paddle this frame
+float latchPaddle(const World& w)
+{
+    float simX = toF(w.paddle.x);
+    if (!pointerActive || state != STATE_PLAYING) return simX;
+    int px;
+    double us;
+    readPointer(&px, &us);
+    float half = toF(w.paddle.width) / 2;
+    float x = std::max(-1.0f + half, std::min(1.0f - half, pointerToWorld(px)));
+    histRecord(H_LATCH_PX, (unsigned int)(fabsf(x - simX) * g_winW / 2.0f + 0.5f));
+    if (simPointerUs > 0.0) histRecord(H_LATCH_GAIN_US, (unsigned int)std::max(0.0, us - simPointerUs));
+    return x;
+}
+
+// -------------------------- Game control --------------------------
+// xorshift; deterministic per world
+int worldRand(World& w)
+{
+    unsigned int x = w.rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    w.rng = x;
+    return (int)(x & 0x7fffffff);
+}
+
+void pushEvent(World& w, WorldEventKind kind, int a, int b)
+{
+    if (w.eventCount >= MAX_WORLD_EVENTS) return;
+    WorldEvent& e = w.events[w.eventCount++];
+    e.kind = kind;
+    e.a = a;
+    e.b = b;
+    e.count = 1;
+    e.seq = 0;
+}
+
+void journalBrick(World& w, int cell, BrickChangeKind kind, unsigned char value)
+{
+    BrickChange& c = w.journal.ring[w.journal.head++ & (BRICK_JOURNAL_SIZE - 1)];
+    c.cell = cell;
+    c.kind = (unsigned char)kind;
+    c.value = value;
+}
+
+// Where a journal consumer has read up to
+struct BrickCursor
+{
+    unsigned int board;     // 0 = not following any
+    unsigned int seq;
+};
+
+// f(change) for each change since the cursor, oldest first, and move the cursor
+// up. False, with nothing handed over, when the consumer has to rebuild from
+// the cells instead: the board was replaced or the ring wrapped past it.
+template <class F>
+bool readJournal(const World& w, BrickCursor& c, F f)
+{
+    const BrickJournal& j = w.journal;
+    bool ok = c.board && c.board == j.board && j.head - c.seq <= BRICK_JOURNAL_SIZE;
+    if (ok)
+        for (; c.seq != j.head; ++c.seq) f(j.ring[c.seq & (BRICK_JOURNAL_SIZE - 1)]);
+    c.board = j.board;
+    c.seq = j.head;
+    return ok;
+}
+
+// ----- Effect heap -----
+void effectSiftUp(EffectStore& es, int i)
+{
+    TimedEffect e = es.heap[i];
+    while (i > 0)
+    {
+        int parent = (i - 1) / 2;
+        if (es.heap[parent].deadlineMs <= e.deadlineMs) break;
+        es.heap[i] = es.heap[parent];
+        i = parent;
+    }
+    es.heap[i] = e;
+}
+
+void effectSiftDown(EffectStore& es, int i)
+{
+    TimedEffect e = es.heap[i];
+    for (;;)
+    {
+        int child = 2*i + 1;
+        if (child >= es.count) break;
+        if (child + 1 < es.count && es.heap[child + 1].deadlineMs < es.heap[child].deadlineMs) child++;
+        if (e.deadlineMs <= es.heap[child].deadlineMs) break;
+        es.heap[i] = es.heap[child];
+        i = child;
+    }
+    es.heap[i] = e;
+}
+
+bool pushEffect(World& w, EffectKind kind, int deadlineMs)
+{
+    EffectStore& es = w.effects;
+    if (es.count >= MAX_EFFECTS) return false;
+    es.heap[es.count].kind = kind;
+    es.heap[es.count].deadlineMs = deadlineMs;
+    effectSiftUp(es, es.count++);
+    return true;
+}
+
+void removeEffectAt(EffectStore& es, int i)
+{
+    es.heap[i] = es.heap[--es.count];
+    if (i < es.count)
+    {
+        effectSiftUp(es, i);
+        effectSiftDown(es, i);
+    }
+}
+
+int countEffects(const World& w, EffectKind kind)
+{
+    int n = 0;
+    for (int i = 0; i < w.effects.count; ++i)
+        if (w.effects.heap[i].kind == kind) n++;
+    return n;
+}
+
+// Ball speed multiplier from the fast-ball pickups still running
+void applyFastBall(World& w)
+{
+    real mul = 1.0f;
+    for (int n = countEffects(w, EFFECT_FAST_BALL); n > 0; --n) mul *= FAST_BALL_FACTOR;
+    w.ball.speedMul = mul;
+}
+
+void resetBall(World& w)
+{
+    Ball& b = w.ball;
+    b.x = 0.0f;
+    b.y = -0.5f;
+    b.dx = 0.008f * ((worldRand(w) % 2) ? 1.0f : -1.0f);
+    b.dy = 0.01f;
+    b.moving = false;
+    // a lost ball loses its speed-ups
+    for (int i = w.effects.count - 1; i >= 0; --i)
+        if (w.effects.heap[i].kind == EFFECT_FAST_BALL) removeEffectAt(w.effects, i);
+    applyFastBall(w);
+    // clear trail
+    for (int i = 0; i < TRAIL_LEN; ++i)
+    {
+        b.trailX[i] = b.x;
+        b.trailY[i] = b.y;
+    }
+}
+
+// Point the brick store at a board; cells are used in place. Journal consumers
+// see a new board and rebuild.
+std::atomic<unsigned int> boardSerial(0);
+
+void setBoard(World& w, unsigned char* cells, int rows, int cols, int brickCount)
+{
+    w.journal.board = boardSerial.fetch_add(1) + 1;
+    w.journal.head = w.journal.tickStart = 0;
+    w.bricks.cell = cells;
+    w.bricks.rows = rows;
+    w.bricks.cols = cols;
+    w.bricks.aliveCount = brickCount;
+    w.bricks.liveTop = 0;
+    w.bricks.liveBottom = rows - 1;
+    computeBrickLayout(w.bricks);
+}
+
+// Built-in level. '1'-'9' normal bricks with that many hit points,
+// 's' steel, 'e' explosive, 'p' power-up, '.' empty. The default board stays
+// plain; the other types come with level files (--make-level) and the generator.
+const char* builtinBoard[ROWS] =
+{
+    "11111111",
+    "11111111",
+    "11111111",
+    "11111111",
+    "11111111",
+};
+
+unsigned char brickFromChar(char ch)
+{
+    if (ch >= '1' && ch <= '9') return BRICK_CELL(BRICK_NORMAL, ch - '0');
+    if (ch == 's') return BRICK_CELL(BRICK_STEEL, 1);
+    if (ch == 'e') return BRICK_CELL(BRICK_EXPLOSIVE, 1);
+    if (ch == 'p') return BRICK_CELL(BRICK_POWERUP, 1);
+    return 0;
+}
+
+void useBuiltinBoard(World& w)
+{
+    w.ownedCells.resize(ROWS*COLS);
+    int breakable = 0;
+    for (int i = 0; i < ROWS; ++i)
+        for (int j = 0; j < COLS; ++j)
+        {
+            unsigned char c = brickFromChar(builtinBoard[i][j]);
+            w.ownedCells[i*COLS + j] = c;
+            if (BRICK_BREAKABLE(c)) breakable++;
+        }
+    setBoard(w, w.ownedCells.data(), ROWS, COLS, breakable);
+}
+
+// Fresh paddle, ball and timers on the current board; score and lives carry over
+void startRound(World& w, int now)
+{
+    w.paddle.x = 0.0f;
+    w.paddle.width = PADDLE_START_WIDTH;
+    w.totalPausedMs = 0;
+    w.pauseStartTimeMs = 0;
+    w.gameStartTimeMs = now;
+    w.powerUps.count = 0;
+    w.effects.count = 0;
+    pushEffect(w, EFFECT_SPEED_RAMP, now + SPEED_INCREASE_INTERVAL_MS);
+    w.eventCount = 0;
+    resetBall(w);
+}
+
+void resetWorld(World& w, int now, unsigned int seed)
+{
+    w.rng = seed ? seed : 1u;
+    w.score = 0;
+    w.lives = 3;
+    startRound(w, now);
+}
+
+// -------------------------- Levels --------------------------
+// Binary level file (.dxl), little-endian:
+//   LevelHeader, then rows*cols cell bytes, row-major from the top row.
+//   Cell byte: low nibble = hit points (0 = empty), high nibble = BrickType
+//   (normal, steel, explosive, power-up).
+// Files are mapped copy-on-write and the game plays directly on the mapped
+// cells, so loading is just a header check however big the level is.
+#define LEVEL_MAGIC 0x564c5844u   // "DXLV"
+#define LEVEL_VERSION 1
+#define LEVEL_MAX_CELLS (1 << 22)
+#define LEVEL_MAX_DIM 4096
+
+struct LevelHeader
+{
+    unsigned int magic;
+    unsigned short version;
+    unsigned short headerSize;
+    unsigned int rows, cols;
+    unsigned int brickCount;    // breakable bricks (hit points, not steel)
+    unsigned int checksum;      // FNV-1a over the cell bytes
+    unsigned int reserved[2];
+};
+
+struct LevelMap
+{
+    unsigned char* base;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#endif
+    const LevelHeader* header;
+    unsigned char* cells;
+};
+
+unsigned int levelChecksum(const unsigned char* p, size_t n)
+{
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < n; ++i)
+    {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void unmapLevel(LevelMap& m)
+{
+    if (!m.base) return;
+#ifdef _WIN32
+    UnmapViewOfFile(m.base);
+    CloseHandle(m.mapping);
+    CloseHandle(m.file);
+#else
+    munmap(m.base, m.size);
+#endif
+    memset(&m, 0, sizeof(m));
+}
+
+// Header sanity only; cheap enough for the game thread
+bool checkLevelHeader(const LevelMap& m, char* err)
+{
+    const LevelHeader* h = (const LevelHeader*)m.base;
+    if (m.size < sizeof(LevelHeader) || h->magic != LEVEL_MAGIC)
+    {
+        strcpy(err, "not a level file");
+        return false;
+    }
+    if (h->version != LEVEL_VERSION || h->headerSize < sizeof(LevelHeader))
+    {
+        strcpy(err, "unsupported level version");
+        return false;
+    }
+    if (h->rows == 0 || h->cols == 0 || h->rows > LEVEL_MAX_DIM || h->cols > LEVEL_MAX_DIM ||
+            (size_t)h->rows * h->cols > LEVEL_MAX_CELLS ||
+            m.size != h->headerSize + (size_t)h->rows * h->cols)
+    {
+        strcpy(err, "bad level dimensions");
+        return false;
+    }
+    return true;
+}
+
+bool mapLevel(LevelMap& m, const char* path, char* err)
+{
+    memset(&m, 0, sizeof(m));
+#ifdef _WIN32
+    m.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m.file == INVALID_HANDLE_VALUE)
+    {
+        sprintf(err, "cannot open %s", path);
+        return false;
+    }
+    LARGE_INTEGER sz;
+    GetFileSizeEx(m.file, &sz);
+    m.size = (size_t)sz.QuadPart;
+    m.mapping = CreateFileMappingA(m.file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    m.base = m.mapping ? (unsigned char*)MapViewOfFile(m.mapping, FILE_MAP_COPY, 0, 0, 0) : NULL;
+    if (!m.base)
+    {
+        if (m.mapping) CloseHandle(m.mapping);
+        CloseHandle(m.file);
+        sprintf(err, "cannot map %s", path);
+        return false;
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        sprintf(err, "cannot open %s", path);
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    m.size = (size_t)st.st_size;
+    // private mapping: brick damage lands in our copy, never in the file
+    void* p = m.size ? mmap(NULL, m.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        sprintf(err, "cannot map %s", path);
+        return false;
+    }
+    m.base = (unsigned char*)p;
+#endif
+    if (!checkLevelHeader(m, err))
+    {
+        unmapLevel(m);
+        return false;
+    }
+    m.header = (const LevelHeader*)m.base;
+    m.cells = m.base + m.header->headerSize;
+    return true;
+}
+
+// Full validation: checksum and brick count. Touches every page, so it also
+// pulls the whole level into memory - run it off the game thread.
+bool validateLevel(const LevelMap& m, char* err)
+{
+    const LevelHeader* h = m.header;
+    size_t n = (size_t)h->rows * h->cols;
+    unsigned int bricks = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (BRICK_TYPE(m.cells[i]) > BRICK_POWERUP)
+        {
+            strcpy(err, "unknown brick type");
+            return false;
+        }
+        if (BRICK_BREAKABLE(m.cells[i])) bricks++;
+    }
+    if (bricks != h->brickCount)
+    {
+        strcpy(err, "brick count mismatch");
+        return false;
+    }
+    if (levelChecksum(m.cells, n) != h->checksum)
+    {
+        strcpy(err, "checksum mismatch");
+        return false;
+    }
+    return true;
+}
+
+bool writeLevel(const char* path, int rows, int cols, const unsigned char* cells)
+{
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    LevelHeader h;
+    memset(&h, 0, sizeof(h));
+    size_t n = (size_t)rows * cols;
+    h.magic = LEVEL_MAGIC;
+    h.version = LEVEL_VERSION;
+    h.headerSize = sizeof(LevelHeader);
+    h.rows = rows;
+    h.cols = cols;
+    for (size_t i = 0; i < n; ++i)
+        if (BRICK_BREAKABLE(cells[i])) h.brickCount++;
+    h.checksum = levelChecksum(cells, n);
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(cells, 1, n, f) == n;
+    fclose(f);
+    return ok;
+}
+
+// --make-level: a simple test pattern, one or two hit points per brick
+bool makeLevelFile(const char* path, int rows, int cols)
+{
+    std::vector<unsigned char> cells((size_t)rows * cols);
+    for (int i = 0; i < rows; ++i)
+        for (int j = 0; j < cols; ++j)
+        {
+            int k = i*cols + j;
+            unsigned char c = BRICK_CELL(BRICK_NORMAL, k % 5 == 0 ? 2 : 1);
+            if ((i + j) % 7 == 0) c = 0;
+            else if (k % 53 == 0) c = BRICK_CELL(BRICK_EXPLOSIVE, 1);
+            else if (k % 61 == 0) c = BRICK_CELL(BRICK_POWERUP, 1);
+            else if (k % 89 == 0) c = BRICK_CELL(BRICK_STEEL, 1);
+            cells[(size_t)k] = c;
+        }
+    return writeLevel(path, rows, cols, cells.data());
+}
+
+// -------------------------- Campaign --------------------------
+// An ordered list of level files. While one level is played, the next one is
+// mapped and validated on a background thread, so the switch after a win is
+// only a pointer swap.
+#define MAX_CAMPAIGN_LEVELS 64
+enum PrefetchStatus { PREFETCH_IDLE, PREFETCH_LOADING, PREFETCH_READY, PREFETCH_FAILED };
+
+struct Campaign
+{
+    int count;
+    char paths[MAX_CAMPAIGN_LEVELS][260];
+    int current;                // level being played
+    LevelMap map;               // its mapping
+    LevelMap next;              // prefetched mapping of nextIndex
+    int nextIndex;
+    std::atomic<int> prefetch;
+    std::thread prefetchThread;
+    char prefetchErr[128];
+};
+Campaign campaign;
+
+bool campaignActive()
+{
+    return campaign.count > 0;
+}
+
+bool addCampaignLevel(const char* path)
+{
+    if (campaign.count >= MAX_CAMPAIGN_LEVELS) return false;
+    snprintf(campaign.paths[campaign.count], sizeof(campaign.paths[0]), "%s", path);
+    campaign.count++;
+    return true;
+}
+
+// One level path per line; blank lines and # comments skipped
+bool loadCampaignFile(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char line[260];
+    while (fgets(line, sizeof(line), f))
+    {
+        char* p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        p[strcspn(p, "\r\n")] = '\0';
+        if (*p && *p != '#') addCampaignLevel(p);
+    }
+    fclose(f);
+    return campaign.count > 0;
+}
+
+void prefetchMain(int index)
+{
+    LevelMap m;
+    if (mapLevel(m, campaign.paths[index], campaign.prefetchErr) &&
+            !validateLevel(m, campaign.prefetchErr))
+        unmapLevel(m);
+    campaign.next = m;
+    campaign.prefetch.store(m.base ? PREFETCH_READY : PREFETCH_FAILED, std::memory_order_release);
+}
+
+void waitPrefetch()
+{
+    if (campaign.prefetchThread.joinable()) campaign.prefetchThread.join();
+}
+
+void startPrefetch(int index)
+{
+    waitPrefetch();
+    if (campaign.next.base) unmapLevel(campaign.next);
+    campaign.nextIndex = index;
+    campaign.prefetch.store(PREFETCH_LOADING);
+    campaign.prefetchThread = std::thread(prefetchMain, index);
+}
+
+void stopCampaign()
+{
+    waitPrefetch();
+    unmapLevel(campaign.next);
+    unmapLevel(campaign.map);
+}
+
+// Make `index` the current level. Uses the prefetched mapping when it is ready;
+// otherwise (first level, or a prefetch still in flight) maps it here.
+bool enterCampaignLevel(int index)
+{
+    char err[128];
+    LevelMap m;
+    memset(&m, 0, sizeof(m));
+    if (campaign.nextIndex == index && campaign.prefetch.load(std::memory_order_acquire) != PREFETCH_IDLE)
+    {
+        waitPrefetch();    // normally already finished
+        m = campaign.next;
+        memset(&campaign.next, 0, sizeof(campaign.next));
+        campaign.prefetch.store(PREFETCH_IDLE);
+        if (!m.base) strcpy(err, campaign.prefetchErr);
+    }
+    else if (mapLevel(m, campaign.paths[index], err) && !validateLevel(m, err))
+    {
+        unmapLevel(m);
+    }
+    if (!m.base)
+    {
+        printf("level %s: %s\n", campaign.paths[index], err);
+        return false;
+    }
+    unmapLevel(campaign.map);
+    campaign.map = m;
+    campaign.current = index;
+    if (index + 1 < campaign.count) startPrefetch(index + 1);
+    return true;
+}
+
+void applyCampaignBoard(World& w)
+{
+    const LevelHeader* h = campaign.map.header;
+    setBoard(w, campaign.map.cells, h->rows, h->cols, h->brickCount);
+}
+
+// Restart: map the current level again for a pristine copy-on-write view
+void reloadCampaignLevel()
+{
+    char err[128];
+    LevelMap m;
+    if (!mapLevel(m, campaign.paths[campaign.current], err))
+    {
+        printf("level %s: %s\n", campaign.paths[campaign.current], err);
+        return;
+    }
+    unmapLevel(campaign.map);
+    campaign.map = m;
+}
+
+// Endless mode state; generation lives with the level generator
+struct Endless
+{
+    unsigned int seed;
+    int level;                          // being played
+    std::vector<unsigned char> first;   // level 0, kept for restarts
+    std::vector<unsigned char> next;    // level + 1, filled in the background
+    std::thread thread;
+};
+Endless endless;
+bool endlessMode = false;
+void startEndless(World& w);
+bool advanceEndless(World& w, int now);
+
+bool hasNextLevel()
+{
+    return endlessMode || (campaignActive() && campaign.current + 1 < campaign.count);
+}
+
+// After a win: swap in the prefetched level, keeping score and lives
+bool advanceCampaign(World& w, int now)
+{
+    if (endlessMode) return advanceEndless(w, now);
+    if (!hasNextLevel() || !enterCampaignLevel(campaign.current + 1)) return false;
+    applyCampaignBoard(w);
+    startRound(w, now);
+    return true;
+}
+
+// World seeds for new games, which the score log keeps as the replay reference.
+// The draw code reseeds rand() from its clocks every frame, so seeds come from
+// a generator of their own; otherwise games started in the same star period
+// would share one. Older MinGW builds have a random_device that returns the
+// same sequence every run, so the wall clock is mixed in as well.
+std::mt19937 seedGenerator()
+{
+    unsigned long long clock = (unsigned long long)
+        std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    std::random_device rd;
+    std::seed_seq seq{ rd(), rd(), (unsigned int)clock, (unsigned int)(clock >> 32) };
+    return std::mt19937(seq);
+}
+
+std::mt19937 gameSeeds = seedGenerator();
+
+unsigned int newGameSeed()
+{
+    return (unsigned int)gameSeeds();
+}
+
+void resetGame()
+{
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    endSession(g_world);    // a game given up for a new one still counts
+    if (campaignActive() && !endlessMode)
+    {
+        // a new game starts the campaign over
+        if (campaign.current != 0 || !campaign.map.base)
+            enterCampaignLevel(0);
+        else
+            reloadCampaignLevel();
+    }
+    if (endlessMode) startEndless(g_world);
+    else if (campaignActive() && campaign.map.base) applyCampaignBoard(g_world);
+    else useBuiltinBoard(g_world);
+    unsigned int seed = newGameSeed();
+    resetWorld(g_world, now, seed);
+    beginSession(g_world, seed);
+    reserveFrameBuffers(g_world.bricks);
+    reserveAutopilot(g_world);
+    releasePointer();   // the paddle starts centred
+    clearAnims();
+}
+
+// -------------------------- Audio --------------------------
+// Software mixer on its own thread. The game thread only pushes small commands
+// into a single-producer/single-consumer ring; the mixer owns every voice and
+// never allocates after startup. Output goes to a sink: the sound device
+// (waveOut on Windows), a WAV file, or nowhere.
+#define AUDIO_RATE 48000
+#define AUDIO_BLOCK 480          // 10 ms, multiple of 4 for SIMD
+#define MAX_VOICES 256
+#define AUDIO_CMD_SIZE 256       // power of two
+
+enum SoundId { SND_BRICK, SND_BRICK_HIT, SND_PADDLE, SND_POWERUP, SND_WIN, SND_LOSE, SND_COUNT };
+
+// Mono float samples, zero-padded to whole blocks
+struct Sound
+{
+    float* samples;
+    int blocks;
+};
+Sound sounds[SND_COUNT];
+
+enum AudioOp { AUDIO_PLAY, AUDIO_STOP_SOUND, AUDIO_STOP_ALL };
+struct AudioCmd
+{
+    unsigned char op;
+    unsigned char sound;
+    float gainL, gainR;
+};
+
+enum AudioSinkKind { SINK_NULL, SINK_WAV, SINK_DEVICE };
+struct AudioSink
+{
+    AudioSinkKind kind;
+    FILE* file;                  // SINK_WAV
+    unsigned int dataBytes;
+#ifdef _WIN32
+    HWAVEOUT wave;               // SINK_DEVICE
+    WAVEHDR hdr[4];
+    short buf[4][AUDIO_BLOCK*2];
+    int next;
+#endif
+};
+
+struct Mixer
+{
+    // command ring: game thread writes head, mixer thread writes tail
+    AudioCmd cmds[AUDIO_CMD_SIZE];
+    std::atomic<unsigned int> head;
+    std::atomic<unsigned int> tail;
+
+    // active voices, packed
+    int voiceCount;
+    unsigned char voiceSound[MAX_VOICES];
+    int voiceBlock[MAX_VOICES];
+    float voiceGainL[MAX_VOICES], voiceGainR[MAX_VOICES];
+
+    alignas(16) float mixL[AUDIO_BLOCK];
+    alignas(16) float mixR[AUDIO_BLOCK];
+    alignas(16) short out[AUDIO_BLOCK*2];   // interleaved stereo
+
+    AudioSink sink;
+    std::atomic<bool> running;
+    std::thread thread;
+};
+Mixer g_mixer;
+bool audioEnabled = false;
+
+// Build a sound from a generator; runs once at startup
+void makeSound(SoundId id, float seconds, float f0, float f1, float volume)
+{
+    int n = (int)(seconds * AUDIO_RATE);
+    int blocks = (n + AUDIO_BLOCK - 1) / AUDIO_BLOCK;
+    float* s = (float*)calloc(blocks * AUDIO_BLOCK, sizeof(float));
+    float phase = 0.0f;
+    for (int i = 0; i < n; ++i)
+    {
+        float t = (float)i / n;
+        float f = f0 + (f1 - f0) * t;               // linear sweep
+        phase += f / AUDIO_RATE;
+        phase -= floorf(phase);
+        float sq = phase < 0.5f ? 1.0f : -1.0f;     // soft square: mix with sine
+        float v = 0.6f * sinf(phase * 6.2831853f) + 0.4f * sq;
+        float env = (1.0f - t) * (1.0f - t);
+        if (i < 64) env *= i / 64.0f;               // avoid click on attack
+        s[i] = v * env * volume;
+    }
+    sounds[id].samples = s;
+    sounds[id].blocks = blocks;
+}
+
+void initSounds()
+{
+    makeSound(SND_BRICK,     0.08f, 880.0f, 660.0f, 0.35f);
+    makeSound(SND_BRICK_HIT, 0.05f, 1100.0f, 990.0f, 0.25f);    // damaged, not destroyed
+    makeSound(SND_PADDLE,    0.06f, 330.0f, 300.0f, 0.35f);
+    makeSound(SND_POWERUP,   0.25f, 400.0f, 1200.0f, 0.30f);
+    makeSound(SND_WIN,       0.90f, 500.0f, 1500.0f, 0.35f);
+    makeSound(SND_LOSE,      0.60f, 400.0f, 90.0f, 0.40f);
+}
+
+// Game thread side. Drops the command if the ring is full.
+bool pushAudioCmd(Mixer& m, const AudioCmd& c)
+{
+    unsigned int h = m.head.load(std::memory_order_relaxed);
+    if (h - m.tail.load(std::memory_order_acquire) >= AUDIO_CMD_SIZE) return false;
+    m.cmds[h & (AUDIO_CMD_SIZE - 1)] = c;
+    m.head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+// pan: -1 left .. 1 right
+void playSound(SoundId id, float gain, float pan)
+{
+    if (!audioEnabled) return;
+    AudioCmd c;
+    c.op = AUDIO_PLAY;
+    c.sound = (unsigned char)id;
+    c.gainL = gain * (pan <= 0.0f ? 1.0f : 1.0f - pan);
+    c.gainR = gain * (pan >= 0.0f ? 1.0f : 1.0f + pan);
+    pushAudioCmd(g_mixer, c);
+}
+
+void stopAllSounds()
+{
+    if (!audioEnabled) return;
+    AudioCmd c = { AUDIO_STOP_ALL, 0, 0.0f, 0.0f };
+    pushAudioCmd(g_mixer, c);
+}
+
+// Mixer thread side
+void removeVoice(Mixer& m, int v)
+{
+    int last = --m.voiceCount;
+    m.voiceSound[v] = m.voiceSound[last];
+    m.voiceBlock[v] = m.voiceBlock[last];
+    m.voiceGainL[v] = m.voiceGainL[last];
+    m.voiceGainR[v] = m.voiceGainR[last];
+}
+
+void drainAudioCmds(Mixer& m)
+{
+    unsigned int t = m.tail.load(std::memory_order_relaxed);
+    unsigned int h = m.head.load(std::memory_order_acquire);
+    for (; t != h; ++t)
+    {
+        const AudioCmd& c = m.cmds[t & (AUDIO_CMD_SIZE - 1)];
+        if (c.op == AUDIO_PLAY)
+        {
+            if (m.voiceCount >= MAX_VOICES) continue; // voice limit: drop newest
+            int v = m.voiceCount++;
+            m.voiceSound[v] = c.sound;
+            m.voiceBlock[v] = 0;
+            m.voiceGainL[v] = c.gainL;
+            m.voiceGainR[v] = c.gainR;
+        }
+        else if (c.op == AUDIO_STOP_SOUND)
+        {
+            for (int v = m.voiceCount - 1; v >= 0; --v)
+                if (m.voiceSound[v] == c.sound) removeVoice(m, v);
+        }
+        else
+        {
+            m.voiceCount = 0;
+        }
+    }
+    m.tail.store(t, std::memory_order_release);
+}
+
+// dst += src * gain over one block
+void mixVoice(float* dstL, float* dstR, const float* src, float gainL, float gainR)
+{
+#ifdef DXB_SSE
+    __m128 gl = _mm_set1_ps(gainL);
+    __m128 gr = _mm_set1_ps(gainR);
+    for (int i = 0; i < AUDIO_BLOCK; i += 4)
+    {
+        __m128 s = _mm_loadu_ps(src + i);
+        _mm_store_ps(dstL + i, _mm_add_ps(_mm_load_ps(dstL + i), _mm_mul_ps(s, gl)));
+        _mm_store_ps(dstR + i, _mm_add_ps(_mm_load_ps(dstR + i), _mm_mul_ps(s, gr)));
+    }
+#else
+    for (int i = 0; i < AUDIO_BLOCK; ++i)
+    {
+        dstL[i] += src[i] * gainL;
+        dstR[i] += src[i] * gainR;
+    }
+#endif
+}
+
+// Float L/R -> saturated interleaved 16-bit
+void convertBlock(short* out, const float* l, const float* r)
+{
+#ifdef DXB_SSE
+    __m128 scale = _mm_set1_ps(32767.0f);
+    for (int i = 0; i < AUDIO_BLOCK; i += 4)
+    {
+        __m128i li = _mm_cvtps_epi32(_mm_mul_ps(_mm_load_ps(l + i), scale));
+        __m128i ri = _mm_cvtps_epi32(_mm_mul_ps(_mm_load_ps(r + i), scale));
+        __m128i lr = _mm_packs_epi32(li, ri);                        // l0..l3 r0..r3
+        __m128i inter = _mm_unpacklo_epi16(lr, _mm_srli_si128(lr, 8)); // l0 r0 l1 r1 ..
+        _mm_store_si128((__m128i*)(out + i*2), inter);
+    }
+#else
+    for (int i = 0; i < AUDIO_BLOCK; ++i)
+    {
+        float a = l[i] * 32767.0f, b = r[i] * 32767.0f;
+        if (a > 32767.0f) a = 32767.0f;
+        if (a < -32768.0f) a = -32768.0f;
+        if (b > 32767.0f) b = 32767.0f;
+        if (b < -32768.0f) b = -32768.0f;
+        out[i*2] = (short)a;
+        out[i*2 + 1] = (short)b;
+    }
+#endif
+}
+
+void mixBlock(Mixer& m)
+{
+    memset(m.mixL, 0, sizeof(m.mixL));
+    memset(m.mixR, 0, sizeof(m.mixR));
+    int v = 0;
+    while (v < m.voiceCount)
+    {
+        const Sound& s = sounds[m.voiceSound[v]];
+        mixVoice(m.mixL, m.mixR, s.samples + m.voiceBlock[v] * AUDIO_BLOCK,
+                 m.voiceGainL[v], m.voiceGainR[v]);
+        if (++m.voiceBlock[v] >= s.blocks) removeVoice(m, v);
+        else ++v;
+    }
+    convertBlock(m.out, m.mixL, m.mixR);
+}
+
+void writeWavHeader(FILE* f, unsigned int dataBytes)
+{
+    unsigned int rate = AUDIO_RATE, byteRate = AUDIO_RATE * 4, riff = 36 + dataBytes, fmtLen = 16;
+    unsigned short fmt = 1, channels = 2, align = 4, bits = 16;
+    fseek(f, 0, SEEK_SET);
+    fwrite("RIFF", 1, 4, f);
+    fwrite(&riff, 4, 1, f);
+    fwrite("WAVEfmt ", 1, 8, f);
+    fwrite(&fmtLen, 4, 1, f);
+    fwrite(&fmt, 2, 1, f);
+    fwrite(&channels, 2, 1, f);
+    fwrite(&rate, 4, 1, f);
+    fwrite(&byteRate, 4, 1, f);
+    fwrite(&align, 2, 1, f);
+    fwrite(&bits, 2, 1, f);
+    fwrite("data", 1, 4, f);
+    fwrite(&dataBytes, 4, 1, f);
+}
+
+bool openAudioSink(AudioSink& s, AudioSinkKind kind, const char* path)
+{
+    memset(&s, 0, sizeof(s));
+    s.kind = kind;
+    if (kind == SINK_WAV)
+    {
+        s.file = fopen(path, "wb");
+        if (!s.file) return false;
+        writeWavHeader(s.file, 0);
+    }
+#ifdef _WIN32
+    if (kind == SINK_DEVICE)
+    {
+        WAVEFORMATEX fmt;
+        memset(&fmt, 0, sizeof(fmt));
+        fmt.wFormatTag = WAVE_FORMAT_PCM;
+        fmt.nChannels = 2;
+        fmt.nSamplesPerSec = AUDIO_RATE;
+        fmt.wBitsPerSample = 16;
+        fmt.nBlockAlign = 4;
+        fmt.nAvgBytesPerSec = AUDIO_RATE * 4;
+        if (waveOutOpen(&s.wave, WAVE_MAPPER, &fmt, 0, 0, CALLBACK_NULL) != MMSYSERR_NOERROR)
+            return false;
+        for (int i = 0; i < 4; ++i)
+        {
+            s.hdr[i].lpData = (LPSTR)s.buf[i];
+            s.hdr[i].dwBufferLength = sizeof(s.buf[i]);
+            waveOutPrepareHeader(s.wave, &s.hdr[i], sizeof(WAVEHDR));
+            s.hdr[i].dwFlags |= WHDR_DONE;
+        }
+    }
+#else
+    if (kind == SINK_DEVICE) return false;
+#endif
+    return true;
+}
+
+// Device sink blocks until a buffer frees up; the others return at once
+void writeAudioSink(AudioSink& s, const short* frames)
+{
+    if (s.kind == SINK_WAV)
+    {
+        fwrite(frames, sizeof(short), AUDIO_BLOCK*2, s.file);
+        s.dataBytes += AUDIO_BLOCK * 4;
+    }
+#ifdef _WIN32
+    else if (s.kind == SINK_DEVICE)
+    {
+        WAVEHDR& h = s.hdr[s.next];
+        while (!(h.dwFlags & WHDR_DONE)) Sleep(1);
+        memcpy(s.buf[s.next], frames, sizeof(s.buf[s.next]));
+        h.dwFlags &= ~WHDR_DONE;
+        waveOutWrite(s.wave, &h, sizeof(WAVEHDR));
+        s.next = (s.next + 1) % 4;
+    }
+#endif
+}
+
+void closeAudioSink(AudioSink& s)
+{
+    if (s.kind == SINK_WAV && s.file)
+    {
+        writeWavHeader(s.file, s.dataBytes);
+        fclose(s.file);
+        s.file = NULL;
+    }
+#ifdef _WIN32
+    if (s.kind == SINK_DEVICE)
+    {
+        waveOutReset(s.wave);
+        for (int i = 0; i < 4; ++i) waveOutUnprepareHeader(s.wave, &s.hdr[i], sizeof(WAVEHDR));
+        waveOutClose(s.wave);
+    }
+#endif
+}
+
+void mixerThreadMain(Mixer* m)
+{
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    while (m->running.load(std::memory_order_acquire))
+    {
+        drainAudioCmds(*m);
+        double t0 = nowUs();
+        mixBlock(*m);
+        histRecord(H_AUDIO_BLOCK_US, (unsigned int)(nowUs() - t0));
+        writeAudioSink(m->sink, m->out);
+        if (m->sink.kind != SINK_DEVICE)
+        {
+            // no device clock to block on; pace to real time
+            next += std::chrono::microseconds(AUDIO_BLOCK * 1000000LL / AUDIO_RATE);
+            std::this_thread::sleep_until(next);
+        }
+    }
+}
+
+bool startAudio(AudioSinkKind kind, const char* path)
+{
+    initSounds();
+    g_mixer.head.store(0);
+    g_mixer.tail.store(0);
+    g_mixer.voiceCount = 0;
+    if (!openAudioSink(g_mixer.sink, kind, path))
+    {
+        printf("audio: could not open sink, using null sink\n");
+        openAudioSink(g_mixer.sink, SINK_NULL, NULL);
+    }
+    g_mixer.running.store(true);
+    g_mixer.thread = std::thread(mixerThreadMain, &g_mixer);
+    audioEnabled = true;
+    return true;
+}
+
+void stopAudio()
+{
+    if (!audioEnabled) return;
+    audioEnabled = false;
+    g_mixer.running.store(false);
+    g_mixer.thread.join();
+    closeAudioSink(g_mixer.sink);
+}
+
+// -------------------------- Score log --------------------------
+// Finished games are appended to a memory-mapped file (dxball_scores.dat):
+//   ScoreHeader, then fixed-size SessionRecords in the order they were played.
+// Every record carries its own checksum, so a write torn by a crash just ends
+// the log there. The header keeps a checksummed top-N index and the number of
+// records it covers; opening only reads records past that count, so the
+// leaderboard is ready at startup without a scan. The game thread hands records
+// to a writer thread through a single-producer/single-consumer ring, and the
+// writer commits whatever has queued up as one batch with one flush, so the
+// frame loop never waits on the disk.
+#define SCORE_MAGIC 0x53425844u      // "DXBS"
+#define SCORE_VERSION 1
+#define RECORD_MAGIC 0x52535844u     // "DXSR"
+#define SCORE_TOP_N 8
+#define SCORE_QUEUE_SIZE 64          // power of two
+#define SCORE_GROW_RECORDS 256       // the file grows this many records at a time
+#define SCORE_COMMIT_MS 50           // how long the writer lets a batch gather
+
+struct SessionRecord
+{
+    unsigned int magic;
+    unsigned int seq;               // position in the log
+    long long endTime;              // seconds since the epoch
+    int score;
+    int playMs;                     // time in play, pauses excluded
+    int livesUsed;
+    int bricksCleared;
+    unsigned int seed;              // replay reference: world seed,
+    unsigned int boardChecksum;     // first board (0 = built-in)
+    int level;                      // and last campaign level reached
+    unsigned int checksum;          // FNV-1a over the fields above
+};
+
+struct TopEntry
+{
+    int score;                      // -1 = empty slot
+    unsigned int seq;
+};
+
+struct ScoreHeader
+{
+    unsigned int magic;
+    unsigned short version;
+    unsigned short headerSize;
+    unsigned int recordSize;
+    unsigned int count;             // records covered by the index
+    TopEntry top[SCORE_TOP_N];      // best first
+    unsigned int checksum;          // FNV-1a over the fields above
+};
+
+struct ScoreStore
+{
+    unsigned char* base;            // writer thread only once it runs
+    size_t size;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#else
+    int fd;
+#endif
+    unsigned int count;             // records in the log
+
+    // the leaderboard as the game thread sees it
+    TopEntry top[SCORE_TOP_N];
+    unsigned int nextSeq;
+
+    // ring: game thread writes head, writer thread writes tail
+    SessionRecord queue[SCORE_QUEUE_SIZE];
+    std::atomic<unsigned int> head;
+    std::atomic<unsigned int> tail;
+    std::atomic<bool> running;
+    std::thread thread;
+    int commits;                    // batches flushed, for --bench
+};
+ScoreStore g_scores;
+bool scoresEnabled = false;
+
+unsigned int recordChecksum(const SessionRecord& r)
+{
+    return levelChecksum((const unsigned char*)&r, offsetof(SessionRecord, checksum));
+}
+
+unsigned int scoreHeaderChecksum(const ScoreHeader& h)
+{
+    return levelChecksum((const unsigned char*)&h, offsetof(ScoreHeader, checksum));
+}
+
+// Keeps the list best first; a tie goes after the scores already there
+void insertTop(TopEntry* top, int score, unsigned int seq)
+{
+    int k = SCORE_TOP_N;
+    while (k > 0 && top[k - 1].score < score) k--;
+    if (k == SCORE_TOP_N) return;
+    memmove(top + k + 1, top + k, (SCORE_TOP_N - 1 - k) * sizeof(TopEntry));
+    top[k].score = score;
+    top[k].seq = seq;
+}
+
+SessionRecord* scoreRecord(ScoreStore& s, unsigned int i)
+{
+    return (SessionRecord*)(s.base + sizeof(ScoreHeader)) + i;
+}
+
+unsigned int scoreCapacity(const ScoreStore& s)
+{
+    return (unsigned int)((s.size - sizeof(ScoreHeader)) / sizeof(SessionRecord));
+}
+
+// (Re)map the file at `size` bytes, growing it if needed
+bool mapScoreFile(ScoreStore& s, size_t size)
+{
+#ifdef _WIN32
+    if (s.base) UnmapViewOfFile(s.base);
+    if (s.mapping) CloseHandle(s.mapping);
+    s.base = NULL;
+    s.mapping = CreateFileMappingA(s.file, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)size, NULL);
+    if (!s.mapping) return false;
+    s.base = (unsigned char*)MapViewOfFile(s.mapping, FILE_MAP_WRITE, 0, 0, size);
+    if (!s.base) return false;
+#else
+    if (s.base) munmap(s.base, s.size);
+    s.base = NULL;
+    struct stat st;
+    if (fstat(s.fd, &st) != 0) return false;
+    if ((size_t)st.st_size < size && ftruncate(s.fd, (off_t)size) != 0) return false;
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, s.fd, 0);
+    if (p == MAP_FAILED) return false;
+    s.base = (unsigned char*)p;
+#endif
+    s.size = size;
+    return true;
+}
+
+// Durable once this returns
+void flushScoreFile(ScoreStore& s, size_t offset, size_t length)
+{
+#ifdef _WIN32
+    FlushViewOfFile(s.base + offset, length);
+    FlushFileBuffers(s.file);
+#else
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = offset & ~(page - 1);
+    msync(s.base + start, offset + length - start, MS_SYNC);
+#endif
+}
+
+void closeScoreFile(ScoreStore& s)
+{
+#ifdef _WIN32
+    if (s.base) UnmapViewOfFile(s.base);
+    if (s.mapping) CloseHandle(s.mapping);
+    if (s.file != INVALID_HANDLE_VALUE) CloseHandle(s.file);
+    s.file = s.mapping = NULL;
+#else
+    if (s.base) munmap(s.base, s.size);
+    if (s.fd >= 0) close(s.fd);
+    s.fd = -1;
+#endif
+    s.base = NULL;
+    s.size = 0;
+}
+
+// Map the log, check the header, and pick up records that were flushed after
+// the last index update. A bad index is rebuilt from the records.
+bool openScoreStore(ScoreStore& s, const char* path, char* err)
+{
+    size_t fileSize;
+#ifdef _WIN32
+    s.mapping = NULL;
+    s.base = NULL;
+    s.file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (s.file == INVALID_HANDLE_VALUE)
+    {
+        sprintf(err, "cannot open %s", path);
+        return false;
+    }
+    LARGE_INTEGER sz;
+    GetFileSizeEx(s.file, &sz);
+    fileSize = (size_t)sz.QuadPart;
+#else
+    s.base = NULL;
+    s.fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (s.fd < 0)
+    {
+        sprintf(err, "cannot open %s", path);
+        return false;
+    }
+    struct stat st;
+    fstat(s.fd, &st);
+    fileSize = (size_t)st.st_size;
+#endif
+    size_t minSize = sizeof(ScoreHeader) + SCORE_GROW_RECORDS * sizeof(SessionRecord);
+    if (!mapScoreFile(s, fileSize > minSize ? fileSize : minSize))
+    {
+        sprintf(err, "cannot map %s", path);
+        closeScoreFile(s);
+        return false;
+    }
+
+    ScoreHeader* h = (ScoreHeader*)s.base;
+    bool fresh = fileSize == 0;
+    if (!fresh && (h->magic != SCORE_MAGIC || h->version != SCORE_VERSION ||
+                   h->headerSize != sizeof(ScoreHeader) || h->recordSize != sizeof(SessionRecord)))
+    {
+        strcpy(err, "not a score log");
+        closeScoreFile(s);
+        return false;
+    }
+    if (fresh || scoreHeaderChecksum(*h) != h->checksum || h->count > scoreCapacity(s))
+    {
+        h->magic = SCORE_MAGIC;
+        h->version = SCORE_VERSION;
+        h->headerSize = sizeof(ScoreHeader);
+        h->recordSize = sizeof(SessionRecord);
+        h->count = 0;
+        for (int k = 0; k < SCORE_TOP_N; ++k) h->top[k].score = -1;
+    }
+
+    unsigned int n = h->count;
+    while (n < scoreCapacity(s))
+    {
+        const SessionRecord& r = *scoreRecord(s, n);
+        if (r.magic != RECORD_MAGIC || r.seq != n || recordChecksum(r) != r.checksum) break;
+        insertTop(h->top, r.score, r.seq);
+        n++;
+    }
+    if (fresh || n != h->count || scoreHeaderChecksum(*h) != h->checksum)
+    {
+        h->count = n;
+        h->checksum = scoreHeaderChecksum(*h);
+        flushScoreFile(s, 0, s.size);
+    }
+    s.count = n;
+    s.nextSeq = n;
+    memcpy(s.top, h->top, sizeof(s.top));
+    s.commits = 0;
+    return true;
+}
+
+// Writer thread: records first, then the index that covers them, one flush each
+void commitScores(ScoreStore& s)
+{
+    unsigned int t = s.tail.load(std::memory_order_relaxed);
+    unsigned int hd = s.head.load(std::memory_order_acquire);
+    if (t == hd) return;
+    unsigned int n = hd - t;
+    if (s.count + n > scoreCapacity(s))
+    {
+        unsigned int grow = (n + SCORE_GROW_RECORDS - 1) / SCORE_GROW_RECORDS * SCORE_GROW_RECORDS;
+        if (!mapScoreFile(s, s.size + grow * sizeof(SessionRecord)))
+        {
+            printf("scores: cannot grow the log, %u sessions not saved\n", n);
+            s.running.store(false);
+            s.tail.store(hd, std::memory_order_release);
+            return;
+        }
+    }
+    for (unsigned int i = 0; i < n; ++i)
+        *scoreRecord(s, s.count + i) = s.queue[(t + i) & (SCORE_QUEUE_SIZE - 1)];
+    flushScoreFile(s, (unsigned char*)scoreRecord(s, s.count) - s.base, n * sizeof(SessionRecord));
+
+    ScoreHeader* h = (ScoreHeader*)s.base;
+    for (unsigned int i = 0; i < n; ++i)
+        insertTop(h->top, scoreRecord(s, s.count + i)->score, s.count + i);
+    s.count += n;
+    h->count = s.count;
+    h->checksum = scoreHeaderChecksum(*h);
+    flushScoreFile(s, 0, sizeof(ScoreHeader));
+    s.tail.store(hd, std::memory_order_release);
+    s.commits++;
+    countMetric(M_SCORE_COMMITS);
+}
+
+void scoreWriterMain(ScoreStore* s)
+{
+    while (s->running.load(std::memory_order_acquire))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(SCORE_COMMIT_MS));
+        commitScores(*s);
+    }
+    commitScores(*s);   // whatever arrived before the stop
+}
+
+// Game thread side: never blocks. Drops the record if the ring is full.
+bool submitSession(ScoreStore& s, SessionRecord r)
+{
+    if (!scoresEnabled) return false;
+    unsigned int hd = s.head.load(std::memory_order_relaxed);
+    if (hd - s.tail.load(std::memory_order_acquire) >= SCORE_QUEUE_SIZE) return false;
+    r.magic = RECORD_MAGIC;
+    r.seq = s.nextSeq++;
+    r.checksum = recordChecksum(r);
+    s.queue[hd & (SCORE_QUEUE_SIZE - 1)] = r;
+    s.head.store(hd + 1, std::memory_order_release);
+    insertTop(s.top, r.score, r.seq);
+    return true;
+}
+
+bool startScoreStore(const char* path)
+{
+    char err[128];
+    if (!openScoreStore(g_scores, path, err))
+    {
+        printf("scores: %s\n", err);
+        return false;
+    }
+    g_scores.head.store(0);
+    g_scores.tail.store(0);
+    g_scores.running.store(true);
+    g_scores.thread = std::thread(scoreWriterMain, &g_scores);
+    scoresEnabled = true;
+    return true;
+}
+
+void stopScoreStore()
+{
+    if (!scoresEnabled) return;
+    scoresEnabled = false;
+    g_scores.running.store(false);
+    g_scores.thread.join();
+    closeScoreFile(g_scores);
+}
+
+// The game being played, as it will go into the log
+struct Session
+{
+    bool open;
+    unsigned int seed;
+    unsigned int boardChecksum;
+    int boardBricks;        // breakable bricks the current board started with
+    int bricksCleared;      // on boards already finished
+    int livesUsed;
+    int playMs;
+};
+Session session;
+
+void beginSession(const World& w, unsigned int seed)
+{
+    memset(&session, 0, sizeof(session));
+    session.open = true;
+    session.seed = seed;
+    if (endlessMode)
+        session.boardChecksum = levelChecksum(w.bricks.cell, (size_t)w.bricks.rows * w.bricks.cols);
+    else
+        session.boardChecksum = campaignActive() && campaign.map.base ? campaign.map.header->checksum : 0;
+    session.boardBricks = w.bricks.aliveCount;
+}
+
+// Logs the game unless it never got going
+void endSession(const World& w)
+{
+    if (!session.open || session.playMs == 0) return;
+    session.open = false;
+    SessionRecord r;
+    memset(&r, 0, sizeof(r));
+    r.endTime = (long long)time(NULL);
+    r.score = w.score;
+    r.playMs = session.playMs;
+    r.livesUsed = session.livesUsed;
+    r.bricksCleared = session.bricksCleared + session.boardBricks - w.bricks.aliveCount;
+    r.seed = session.seed;
+    r.boardChecksum = session.boardChecksum;
+    r.level = endlessMode ? endless.level : campaignActive() ? campaign.current : 0;
+    submitSession(g_scores, r);
+}
+
+// -------------------------- Render scaling --------------------------
+// The playfield (every layer below the HUD) can be drawn into an offscreen
+// target smaller than the window and stretched up with one linear blit; on
+// software rasterisers fill rate is most of the frame. The HUD, overlays and
+// all text are drawn afterwards straight into the window at native resolution.
+// The quality controller picks the scale. Needs framebuffer objects (GL 3.0 or
+// ARB_framebuffer_object); without them the scale stays at 1.
+#define SCALE_FUNCS(X) \
+    X(PFNGLGENFRAMEBUFFERSPROC, GenFramebuffers) \
+    X(PFNGLBINDFRAMEBUFFERPROC, BindFramebuffer) \
+    X(PFNGLFRAMEBUFFERTEXTURE2DPROC, FramebufferTexture2D) \
+    X(PFNGLCHECKFRAMEBUFFERSTATUSPROC, CheckFramebufferStatus) \
+    X(PFNGLBLITFRAMEBUFFERPROC, BlitFramebuffer)
+
+struct ScaleFuncs
+{
+#define X(type, name) type name;
+    SCALE_FUNCS(X)
+#undef X
+} fbo;
+
+const float renderScales[] = { 0.5f, 0.625f, 0.75f, 0.875f, 1.0f };
+#define RENDER_SCALES 5
+
+int renderScaleIdx = RENDER_SCALES - 1;
+bool renderScaleAuto = true;        // --render-scale=<fraction> pins it
+bool renderScaleSupported = false;
+GLuint sceneFbo = 0, sceneTex = 0;
+int sceneTexW = 0, sceneTexH = 0;   // allocated at window size, drawn in a corner
+GLint windowFbo = 0;                // whatever was bound when the frame started
+bool sceneActive = false;           // drawing is going into sceneFbo
+int g_viewW = 900, g_viewH = 700;   // pixel size of the current render target
+
+float renderScale()
+{
+    return renderScaleSupported ? renderScales[renderScaleIdx] : 1.0f;
+}
+
+bool initRenderScale()
+{
+#define X(type, name) \
+    fbo.name = (type)glutGetProcAddress("gl" #name); \
+    if (!fbo.name) { printf("render scale: missing gl" #name ", drawing at full size\n"); return false; }
+    SCALE_FUNCS(X)
+#undef X
+    fbo.GenFramebuffers(1, &sceneFbo);
+    glGenTextures(1, &sceneTex);
+    renderScaleSupported = true;
+    return true;
+}
+
+// Point the offscreen target at a texture the size of the window
+bool allocSceneTarget()
+{
+    glBindTexture(GL_TEXTURE_2D, sceneTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, g_winW, g_winH, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    fbo.BindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+    fbo.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneTex, 0);
+    bool ok = fbo.CheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    fbo.BindFramebuffer(GL_FRAMEBUFFER, windowFbo);
+    sceneTexW = g_winW;
+    sceneTexH = g_winH;
+    if (!ok)
+    {
+        printf("render scale: offscreen target incomplete, drawing at full size\n");
+        renderScaleSupported = false;
+    }
+    return ok;
+}
+
+// Start a frame: clear, and send the playfield offscreen if it is scaled
+void beginScene()
+{
+    g_viewW = g_winW;
+    g_viewH = g_winH;
+    float s = renderScale();
+    if (s < 1.0f)
+    {
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &windowFbo);
+        if ((sceneTexW != g_winW || sceneTexH != g_winH) && !allocSceneTarget())
+            s = 1.0f;
+    }
+    if (s >= 1.0f)
+    {
+        glClear(GL_COLOR_BUFFER_BIT);
+        return;
+    }
+    g_viewW = (int)(g_winW * s + 0.5f);
+    g_viewH = (int)(g_winH * s + 0.5f);
+    if (g_viewW < 1) g_viewW = 1;
+    if (g_viewH < 1) g_viewH = 1;
+    fbo.BindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+    glViewport(0, 0, g_viewW, g_viewH);
+    glClear(GL_COLOR_BUFFER_BIT);
+    sceneActive = true;
+}
+
+// Stretch the playfield over the window and carry on drawing there
+void endScene()
+{
+    if (!sceneActive) return;
+    fbo.BindFramebuffer(GL_READ_FRAMEBUFFER, sceneFbo);
+    fbo.BindFramebuffer(GL_DRAW_FRAMEBUFFER, windowFbo);
+    fbo.BlitFramebuffer(0, 0, g_viewW, g_viewH, 0, 0, g_winW, g_winH, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    fbo.BindFramebuffer(GL_FRAMEBUFFER, windowFbo);
+    glViewport(0, 0, g_winW, g_winH);
+    g_viewW = g_winW;
+    g_viewH = g_winH;
+    sceneActive = false;
+}
+
+bool setRenderScale(const char* arg)
+{
+    if (!strcmp(arg, "auto"))
+    {
+        renderScaleAuto = true;
+        return true;
+    }
+    float want = (float)atof(arg);
+    if (want <= 0.0f || want > 1.0f) return false;
+    int best = 0;
+    for (int i = 1; i < RENDER_SCALES; ++i)
+        if (fabsf(renderScales[i] - want) < fabsf(renderScales[best] - want)) best = i;
+    renderScaleIdx = best;
+    renderScaleAuto = false;
+    return true;
+}
+
+// -------------------------- Deferred text --------------------------
+// Bitmap text waiting for the geometry under it to be drawn. Both render paths
+// batch their geometry, so drawText queues here while a frame is being built.
+struct PendingText
+{
+    float x, y;
+    float color[4];
+    int layer;
+    char text[48];
+};
+#define MAX_PENDING_TEXT 64
+PendingText pendingText[MAX_PENDING_TEXT];
+int pendingTextCount = 0;
+bool deferText = false;
+
+void drawTextEntry(const PendingText& p)
+{
+    glColor4fv(p.color);
+    glRasterPos2f(p.x, p.y);
+    for (const char* c = p.text; *c != '\0'; ++c)
+        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
+}
+
+void drawPendingText()
+{
+    for (int i = 0; i < pendingTextCount; ++i)
+        drawTextEntry(pendingText[i]);
+    pendingTextCount = 0;
+}
+
+// -------------------------- Draw command buffer (legacy path) --------------------------
+// The immediate-mode draw functions record into this buffer instead of calling
+// glBegin/glEnd. Each command carries the pipeline state it needs (blend, line
+// width or point size, texture) and a layer. At the end of the frame commands
+// are sorted by layer, then state, and each run with the same state goes out as
+// one glDrawArrays. Layers keep the back-to-front order; inside a layer fills
+// come before lines and lines before points, so a layer only holds things whose
+// relative order doesn't matter beyond that. Quads, fans and loops are turned
+// into triangles and line pairs at record time so any two runs can be merged.
+enum DrawLayer
+{
+    LAYER_BACKGROUND,
+    LAYER_BRICKS,
+    LAYER_TRAIL,
+    LAYER_PADDLE,
+    LAYER_BALL_GLOW,
+    LAYER_BALL,
+    LAYER_POWERUPS,
+    LAYER_ANIMS,
+    LAYER_HUD,
+    LAYER_DIM,
+    LAYER_PANEL,
+    LAYER_FIREWORKS,
+    LAYER_COUNT
+};
+
+struct CmdVertex
+{
+    float x, y;
+    float r, g, b, a;
+};
+
+// key, most significant first: layer | fill/line/point | blend | size*16 | texture
+struct DrawCmd
+{
+    unsigned long long key;
+    int first, count;
+};
+#define CMD_LAYER(k)   ((int)((k) >> 56))
+#define CMD_RANK(k)    ((int)((k) >> 48) & 0xff)
+#define CMD_BLEND(k)   ((int)((k) >> 40) & 0xff)
+#define CMD_SIZE(k)    ((int)((k) >> 24) & 0xffff)
+#define CMD_TEXTURE(k) ((GLuint)((k) & 0xffffff))
+
+struct CmdState
+{
+    int layer;
+    bool blend;
+    float lineWidth, pointSize;
+    GLuint texture;     // 0 = untextured; nothing binds one yet
+    float color[4];
+};
+
+std::vector<CmdVertex> cmdVerts, cmdSorted, cmdScratch;
+std::vector<DrawCmd> cmdList, cmdRuns;
+std::vector<int> cmdOrder;
+CmdState cmdCur;
+GLenum cmdPrim = GL_POINTS;
+int cmdFirst = 0;
+bool cmdRecording = false;
+float cmdOffX = 0.0f, cmdOffY = 0.0f;   // screen shake and camera for gameplay geometry
+
+// Per-frame counts, summed for --gl-stats. The recorded figures are what the
+// draw code asked for: one draw per begin/end pair and one state call per setter,
+// i.e. what immediate mode used to send.
+int cmdDrawCalls = 0, cmdStateChanges = 0;
+int cmdRecordedDraws = 0, cmdRecordedChanges = 0;
+
+void cmdReset()
+{
+    cmdCur.layer = LAYER_BACKGROUND;
+    cmdCur.blend = false;
+    cmdCur.lineWidth = cmdCur.pointSize = 1.0f;
+    cmdCur.texture = 0;
+    cmdCur.color[0] = cmdCur.color[1] = cmdCur.color[2] = cmdCur.color[3] = 1.0f;
+    cmdRecordedChanges = 0;
+}
+
+void cmdLayer(DrawLayer layer) { cmdCur.layer = layer; }
+void cmdBlend(bool on) { cmdCur.blend = on; cmdRecordedChanges++; }
+void cmdLineWidth(float w) { cmdCur.lineWidth = w; cmdRecordedChanges++; }
+void cmdPointSize(float s) { cmdCur.pointSize = s; cmdRecordedChanges++; }
+
+void cmdColor4f(float r, float g, float b, float a)
+{
+    cmdCur.color[0] = r;
+    cmdCur.color[1] = g;
+    cmdCur.color[2] = b;
+    cmdCur.color[3] = a;
+}
+
+void cmdColor3f(float r, float g, float b)
+{
+    cmdColor4f(r, g, b, 1.0f);
+}
+
+void cmdVertex2f(float x, float y)
+{
+    CmdVertex v = { x + cmdOffX, y + cmdOffY, cmdCur.color[0], cmdCur.color[1], cmdCur.color[2], cmdCur.color[3] };
+    cmdVerts.push_back(v);
+}
+
+void cmdBegin(GLenum prim)
+{
+    cmdPrim = prim;
+    cmdFirst = (int)cmdVerts.size();
+}
+
+void cmdEnd()
+{
+    int n = (int)cmdVerts.size() - cmdFirst;
+    int rank = 0;   // 0 triangles, 1 lines, 2 points
+    if (cmdPrim == GL_QUADS || cmdPrim == GL_TRIANGLE_FAN || cmdPrim == GL_LINE_LOOP)
+    {
+        cmdScratch.assign(cmdVerts.begin() + cmdFirst, cmdVerts.end());
+        cmdVerts.resize(cmdFirst);
+        const CmdVertex* v = cmdScratch.data();
+        if (cmdPrim == GL_QUADS)
+            for (int i = 0; i + 3 < n; i += 4)
+            {
+                cmdVerts.push_back(v[i]);
+                cmdVerts.push_back(v[i + 1]);
+                cmdVerts.push_back(v[i + 2]);
+                cmdVerts.push_back(v[i]);
+                cmdVerts.push_back(v[i + 2]);
+                cmdVerts.push_back(v[i + 3]);
+            }
+        else if (cmdPrim == GL_TRIANGLE_FAN)
+            for (int i = 1; i + 1 < n; ++i)
+            {
+                cmdVerts.push_back(v[0]);
+                cmdVerts.push_back(v[i]);
+                cmdVerts.push_back(v[i + 1]);
+            }
+        else
+        {
+            for (int i = 0; i < n && n > 1; ++i)
+            {
+                cmdVerts.push_back(v[i]);
+                cmdVerts.push_back(v[(i + 1) % n]);
+            }
+            rank = 1;
+        }
+    }
+    else if (cmdPrim == GL_LINES) rank = 1;
+    else if (cmdPrim == GL_POINTS) rank = 2;
+
+    n = (int)cmdVerts.size() - cmdFirst;
+    if (n <= 0) return;
+    float size = rank == 1 ? cmdCur.lineWidth : rank == 2 ? cmdCur.pointSize : 0.0f;
+    DrawCmd c;
+    c.key = ((unsigned long long)cmdCur.layer << 56) |
+            ((unsigned long long)rank << 48) |
+            ((unsigned long long)cmdCur.blend << 40) |
+            ((unsigned long long)((int)(size * 16.0f) & 0xffff) << 24) |
+            (cmdCur.texture & 0xffffff);
+    c.first = cmdFirst;
+    c.count = n;
+    cmdList.push_back(c);
+}
+
+// Prebuilt triangles as one command; not moved by the screen shake
+void cmdTriangles(const CmdVertex* v, int n)
+{
+    cmdBegin(GL_TRIANGLES);
+    cmdVerts.insert(cmdVerts.end(), v, v + n);
+    cmdEnd();
+}
+
+// Tracks GL state during submission and counts the calls that change it
+struct CmdGLState
+{
+    int blend, lineSize, pointSize;
+    GLuint texture;
+    int changes;
+
+    void reset()
+    {
+        blend = 0;
+        lineSize = pointSize = 16;
+        texture = 0;
+        changes = 0;
+    }
+    void set(unsigned long long key)
+    {
+        int rank = CMD_RANK(key), size = CMD_SIZE(key);
+        if (CMD_BLEND(key) != blend)
+        {
+            blend = CMD_BLEND(key);
+            if (blend) glEnable(GL_BLEND); else glDisable(GL_BLEND);
+            changes++;
+        }
+        if (rank == 1 && size != lineSize)
+        {
+            lineSize = size;
+            glLineWidth(size / 16.0f);
+            changes++;
+        }
+        if (rank == 2 && size != pointSize)
+        {
+            pointSize = size;
+            glPointSize(size / 16.0f);
+            changes++;
+        }
+        if (CMD_TEXTURE(key) != texture)
+        {
+            texture = CMD_TEXTURE(key);
+            if (texture) glEnable(GL_TEXTURE_2D); else glDisable(GL_TEXTURE_2D);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            changes++;
+        }
+    }
+};
+
+// Sort and merge everything recorded this frame into runs; no GL calls
+void cmdSortRuns()
+{
+    int n = (int)cmdList.size();
+    cmdRecordedDraws = n;
+
+    // recorded order breaks ties, so plain sort needs no scratch buffer
+    cmdOrder.resize(n);
+    for (int i = 0; i < n; ++i) cmdOrder[i] = i;
+    std::sort(cmdOrder.begin(), cmdOrder.end(), [](int a, int b)
+    {
+        unsigned long long ka = cmdList[a].key, kb = cmdList[b].key;
+        return ka < kb || (ka == kb && a < b);
+    });
+
+    // gather into draw order; equal keys become one run
+    cmdSorted.clear();
+    cmdRuns.clear();
+    for (int i = 0; i < n; ++i)
+    {
+        const DrawCmd& c = cmdList[cmdOrder[i]];
+        if (cmdRuns.empty() || cmdRuns.back().key != c.key)
+        {
+            DrawCmd r = { c.key, (int)cmdSorted.size(), 0 };
+            cmdRuns.push_back(r);
+        }
+        cmdSorted.insert(cmdSorted.end(), cmdVerts.begin() + c.first, cmdVerts.begin() + c.first + c.count);
+        cmdRuns.back().count += c.count;
+    }
+}
+
+// Sort, merge and submit everything recorded this frame, with each layer's text
+// drawn after its geometry
+void cmdFlush()
+{
+    cmdSortRuns();
+
+    static const GLenum prims[3] = { GL_TRIANGLES, GL_LINES, GL_POINTS };
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_BLEND);
+    glLineWidth(1.0f);
+    glPointSize(1.0f);
+    if (!cmdSorted.empty())
+    {
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(2, GL_FLOAT, sizeof(CmdVertex), &cmdSorted[0].x);
+        glColorPointer(4, GL_FLOAT, sizeof(CmdVertex), &cmdSorted[0].r);
+    }
+    CmdGLState st;
+    st.reset();
+    int draws = 0;
+    size_t run = 0;
+    bool heldText = sceneActive;
+    for (int layer = 0; layer < LAYER_COUNT; ++layer)
+    {
+        // the playfield ends at the HUD; its text waits for native resolution
+        if (layer == LAYER_HUD && heldText)
+        {
+            endScene();
+            for (int i = 0; i < pendingTextCount; ++i)
+                if (pendingText[i].layer < LAYER_HUD) drawTextEntry(pendingText[i]);
+            heldText = false;
+        }
+        for (; run < cmdRuns.size() && CMD_LAYER(cmdRuns[run].key) == layer; ++run)
+        {
+            st.set(cmdRuns[run].key);
+            glDrawArrays(prims[CMD_RANK(cmdRuns[run].key)], cmdRuns[run].first, cmdRuns[run].count);
+            draws++;
+        }
+        if (heldText) continue;
+        for (int i = 0; i < pendingTextCount; ++i)
+            if (pendingText[i].layer == layer) drawTextEntry(pendingText[i]);
+    }
+    cmdDrawCalls = draws;
+    cmdStateChanges = st.changes;
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    st.set(0);    // back to defaults
+    glLineWidth(1.0f);
+    glPointSize(1.0f);
+    pendingTextCount = 0;
+    cmdList.clear();
+    cmdVerts.clear();
+}
+
+// Room for everything but the bricks: background, ball, power-ups, animations,
+// HUD and overlays, with plenty to spare
+#define FRAME_FIXED_VERTS 16384
+#define FRAME_FIXED_CMDS 2048
+#define CMD_VERTS_PER_BRICK 14      // two triangles and four border lines
+
+// The draw keeps its vectors between frames, so they only grow when a frame
+// records more than any before it. Reserving for the level's most visible
+// bricks when it starts leaves nothing to grow in the frames themselves.
+void reserveFrameBuffers(const BrickStore& bs)
+{
+    int rows = std::min(bs.rows, (int)(2.1f * bs.invPitchY) + 2);  // a screen and shake
+    size_t verts = FRAME_FIXED_VERTS + (size_t)rows * bs.cols * CMD_VERTS_PER_BRICK;
+    size_t cmds = FRAME_FIXED_CMDS + (size_t)rows * bs.cols * 2;
+    cmdVerts.reserve(verts);
+    cmdSorted.reserve(verts);
+    cmdScratch.reserve(FRAME_FIXED_VERTS);
+    cmdList.reserve(cmds);
+    cmdRuns.reserve(cmds);
+    cmdOrder.reserve(cmds);
+}
+
+bool queueText(float x, float y, const char* text)
+{
+    if (!deferText) return false;
+    if (pendingTextCount >= MAX_PENDING_TEXT) return true;
+    PendingText& p = pendingText[pendingTextCount++];
+    p.x = x;
+    p.y = y;
+    if (cmdRecording)
+    {
+        p.x += cmdOffX;
+        p.y += cmdOffY;
+        memcpy(p.color, cmdCur.color, sizeof(p.color));
+        p.layer = cmdCur.layer;
+    }
+    else
+    {
+        glGetFloatv(GL_CURRENT_COLOR, p.color);
+        p.layer = 0;
+    }
+    strncpy(p.text, text, sizeof(p.text) - 1);
+    p.text[sizeof(p.text) - 1] = '\0';
+    return true;
+}
+
+// -------------------------- Quality scaling --------------------------
+// Effect detail, then render scale, step down when frames run over budget and
+// come back in the reverse order when there is plenty of room. Frame cost is
+// the CPU time from the start of display() to the swap plus the frame's GPU
+// time, so vsync waits in the swap don't count. Going down takes one bad
+// window, going up takes several calm ones, so the tier doesn't flap.
+struct QualityTier
+{
+    const char* name;
+    int glowStep;       // drawBallGlow layers: 5, 4.. in steps of this
+    int glowDeg;        // circle segment angles
+    int trailDeg;
+    int trailLen;       // trail circles drawn, at most TRAIL_LEN
+    int stars;
+    int fireworks;      // particle cap on the win screen
+};
+
+const QualityTier qualityTiers[] =
+{
+    { "low",    4, 30, 45, 3,         10, 10 },
+    { "medium", 2, 18, 30, 5,         20, 18 },
+    { "high",   1, 12, 18, TRAIL_LEN, 30, 25 },
+};
+#define QUALITY_TIERS 3
+
+const float FRAME_BUDGET_MS = 12.0f;    // leaves headroom in a 16 ms tick
+const float QUALITY_UP_FRACTION = 0.4f; // calm = under this share of the budget
+#define QUALITY_WINDOW 30               // frames per decision
+#define QUALITY_CALM_WINDOWS 4          // calm windows before stepping up
+
+int qualityTier = QUALITY_TIERS - 1;
+bool qualityAuto = true;    // --quality=low|medium|high pins a tier
+
+const QualityTier& quality() { return qualityTiers[qualityTier]; }
+
+void updateQuality(double frameMs)
+{
+    static double sumMs = 0.0;
+    static int frames = 0, calmWindows = 0;
+    bool scaleAuto = renderScaleAuto && renderScaleSupported;
+    if (!qualityAuto && !scaleAuto) return;
+    sumMs += frameMs;
+    if (++frames < QUALITY_WINDOW) return;
+
+    double avgMs = sumMs / frames;
+    sumMs = 0.0;
+    frames = 0;
+    int tier = qualityTier, scale = renderScaleIdx;
+    if (avgMs > FRAME_BUDGET_MS)
+    {
+        calmWindows = 0;
+        if (qualityAuto && tier > 0) tier--;
+        else if (scaleAuto && scale > 0) scale--;
+    }
+    else if (avgMs < FRAME_BUDGET_MS * QUALITY_UP_FRACTION)
+    {
+        if (++calmWindows >= QUALITY_CALM_WINDOWS)
+        {
+            calmWindows = 0;
+            if (scaleAuto && scale < RENDER_SCALES - 1) scale++;
+            else if (qualityAuto && tier < QUALITY_TIERS - 1) tier++;
+        }
+    }
+    else calmWindows = 0;
+
+    if (tier != qualityTier || scale != renderScaleIdx)
+    {
+        printf("quality: %s %d%% -> %s %d%% (%.1f ms per frame, budget %.1f)\n",
+               qualityTiers[qualityTier].name, (int)(renderScales[renderScaleIdx] * 100.0f),
+               qualityTiers[tier].name, (int)(renderScales[scale] * 100.0f), avgMs, FRAME_BUDGET_MS);
+        qualityTier = tier;
+        renderScaleIdx = scale;
+    }
+}
+
+// GPU time per frame from GL_TIME_ELAPSED queries. A few are kept in a ring
+// and read back once the GPU has got to them, a frame or two late, so nothing
+// waits on the GPU. Without timer queries only the CPU time is counted.
+#define GPU_TIMER_FUNCS(X) \
+    X(PFNGLGENQUERIESPROC, GenQueries) \
+    X(PFNGLBEGINQUERYPROC, BeginQuery) \
+    X(PFNGLENDQUERYPROC, EndQuery) \
+    X(PFNGLGETQUERYOBJECTIVPROC, GetQueryObjectiv) \
+    X(PFNGLGETQUERYOBJECTUI64VPROC, GetQueryObjectui64v)
+
+struct GpuTimerFuncs
+{
+#define X(type, name) type name;
+    GPU_TIMER_FUNCS(X)
+#undef X
+} gltimer;
+
+#define GPU_TIMER_QUERIES 4     // frames that can be timed and not yet read
+// Longer results are dropped: some drivers report the start timestamp for the
+// first query of a context
+const GLuint64 GPU_TIMER_MAX_NS = 1000000000;
+
+struct GpuTimer
+{
+    bool supported;
+    bool running;               // a query is open for the frame being drawn
+    GLuint query[GPU_TIMER_QUERIES];
+    unsigned int head, tail;    // queries begun, queries read
+    double lastMs;              // newest result
+};
+GpuTimer gpuTimer;
+
+bool initGpuTimer()
+{
+    const char* ver = (const char*)glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    bool core = ver && sscanf(ver, "%d.%d", &major, &minor) == 2 && major * 10 + minor >= 33;
+    const char* ext = core ? NULL : (const char*)glGetString(GL_EXTENSIONS);
+    if (!core && !(ext && strstr(ext, "GL_ARB_timer_query")))
+    {
+        printf("quality: no GPU timer queries, scaling on CPU time\n");
+        return false;
+    }
+#define X(type, name) \
+    gltimer.name = (type)glutGetProcAddress("gl" #name); \
+    if (!gltimer.name) { printf("quality: missing gl" #name ", scaling on CPU time\n"); return false; }
+    GPU_TIMER_FUNCS(X)
+#undef X
+    gltimer.GenQueries(GPU_TIMER_QUERIES, gpuTimer.query);
+    gpuTimer.supported = true;
+    return true;
+}
+
+// Around the GL work of one frame; skipped when every query is still in flight
+void gpuTimerBegin()
+{
+    if (!gpuTimer.supported || gpuTimer.head - gpuTimer.tail >= GPU_TIMER_QUERIES) return;
+    gltimer.BeginQuery(GL_TIME_ELAPSED, gpuTimer.query[gpuTimer.head % GPU_TIMER_QUERIES]);
+    gpuTimer.running = true;
+}
+
+void gpuTimerEnd()
+{
+    if (!gpuTimer.running) return;
+    gltimer.EndQuery(GL_TIME_ELAPSED);
+    gpuTimer.head++;
+    gpuTimer.running = false;
+}
+
+// GPU time of the newest frame the GPU has finished, without waiting
+double gpuFrameMs()
+{
+    while (gpuTimer.tail != gpuTimer.head)
+    {
+        GLuint q = gpuTimer.query[gpuTimer.tail % GPU_TIMER_QUERIES];
+        GLint ready = 0;
+        gltimer.GetQueryObjectiv(q, GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready) break;
+        GLuint64 ns = 0;
+        gltimer.GetQueryObjectui64v(q, GL_QUERY_RESULT, &ns);
+        if (ns < GPU_TIMER_MAX_NS) gpuTimer.lastMs = ns / 1e6;
+        gpuTimer.tail++;
+    }
+    return gpuTimer.lastMs;
+}
+
+bool setQualityByName(const char* name)
+{
+    if (!strcmp(name, "auto"))
+    {
+        qualityAuto = true;
+        return true;
+    }
+    for (int i = 0; i < QUALITY_TIERS; ++i)
+        if (!strcmp(name, qualityTiers[i].name))
+        {
+            qualityTier = i;
+            qualityAuto = false;
+            return true;
+        }
+    return false;
+}
+
+// -------------------------- Frame pacing --------------------------
+// --frames-in-flight=1|2. GLUT's swap gives no say in how many frames the
+// driver queues, and every queued frame is input lag that comes and goes. With
+// pacing on a fence goes in after each swap, and once the limit is reached the
+// CPU waits on the oldest, so no more than that many frames are in flight. The
+// moment a fence is seen signalled stands in for the present (with vsync the
+// fence after a swap lands on the flip). The present times give the refresh
+// period and where the next vblank falls, and the tick loop wakes just early
+// enough to step, draw and submit before it: the CPU time from tick start to
+// swap is tracked, with a margin for the GPU on top. Ticks keep their own
+// SIM_TICK_MS clock, so a wake runs as many as are due. Present-to-present
+// jitter and the queue depth go to the metrics and to --gl-stats.
+#define PACE_FUNCS(X) \
+    X(PFNGLFENCESYNCPROC, FenceSync) \
+    X(PFNGLCLIENTWAITSYNCPROC, ClientWaitSync) \
+    X(PFNGLDELETESYNCPROC, DeleteSync)
+
+struct SyncFuncs
+{
+#define X(type, name) type name;
+    PACE_FUNCS(X)
+#undef X
+} glsync;
+
+#define PACE_MAX_FRAMES 2
+#define PACE_DEFAULT_PERIOD_US (1e6 / 60.0)
+#define PACE_MARGIN_US 1500.0           // GPU time and timer slack after the swap
+#define PACE_MAX_CATCHUP 4              // ticks on one wake; past that the clock skips
+const GLuint64 PACE_WAIT_NS = 100000000;    // give up on a fence after 100 ms
+
+struct FramePacer
+{
+    int limit;                  // frames in flight, 0 = off
+    GLsync fence[PACE_MAX_FRAMES];
+    int fences;
+    double periodUs;            // refresh period, estimated
+    double lastPresentUs;
+    double workUs;              // tick start to swap; rises at once, decays slowly
+    double tickStartUs;         // of the frame being built, 0 if none
+    int simMs;                  // time of the last tick
+    // summed for --gl-stats
+    int presents, frames, queued;
+    double intervalUs, jitterUs, worstJitterUs;
+};
+FramePacer pace;
+
+bool initFramePacing()
+{
+#define X(type, name) \
+    glsync.name = (type)glutGetProcAddress("gl" #name); \
+    if (!glsync.name) { printf("frame pacing: missing gl" #name ", off\n"); pace.limit = 0; return false; }
+    PACE_FUNCS(X)
+#undef X
+    pace.periodUs = PACE_DEFAULT_PERIOD_US;
+    return true;
+}
+
+// A frame was presented at `us`
+void pacePresented(double us)
+{
+    if (pace.lastPresentUs > 0.0)
+    {
+        double interval = us - pace.lastPresentUs;
+        double jitter = fabs(interval - pace.periodUs);
+        // a missed vblank shows up as jitter but doesn't stretch the period
+        if (interval > pace.periodUs * 0.5 && interval < pace.periodUs * 1.5)
+            pace.periodUs += (interval - pace.periodUs) * 0.05;
+        histRecord(H_PRESENT_JITTER_US, (unsigned int)(jitter + 0.5));
+        pace.presents++;
+        pace.intervalUs += interval;
+        pace.jitterUs += jitter;
+        pace.worstJitterUs = std::max(pace.worstJitterUs, jitter);
+    }
+    pace.lastPresentUs = us;
+}
+
+// The frame that the last tick started was handed to the driver at `us`
+void paceSwapped(double us)
+{
+    if (pace.tickStartUs <= 0.0) return;
+    double work = us - pace.tickStartUs;
+    pace.workUs = work > pace.workUs ? work : pace.workUs + (work - pace.workUs) * 0.02;
+    pace.tickStartUs = 0.0;
+}
+
+// Retire the oldest fence, waiting for it if `wait`; false if it is still
+// pending. A wait that runs out retires it anyway.
+bool paceRetire(bool wait)
+{
+    GLenum r = glsync.ClientWaitSync(pace.fence[0], wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? PACE_WAIT_NS : 0);
+    if (!wait && r == GL_TIMEOUT_EXPIRED) return false;
+    glsync.DeleteSync(pace.fence[0]);
+    pace.fences--;
+    for (int i = 0; i < pace.fences; ++i) pace.fence[i] = pace.fence[i + 1];
+    pacePresented(nowUs());
+    return true;
+}
+
+// After the swap: fence the frame, note what is still queued and hold the CPU
+// back until fewer than `limit` frames are in flight
+void paceFrame()
+{
+    if (!pace.limit) return;
+    paceSwapped(nowUs());
+    pace.fence[pace.fences++] = glsync.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    while (pace.fences > 0 && paceRetire(false)) {}
+    histRecord(H_FRAMES_QUEUED, pace.fences);
+    pace.frames++;
+    pace.queued += pace.fences;
+    while (pace.fences >= pace.limit) paceRetire(true);
+}
+
+// Ticks to run on this wake, the first at *first. Unpaced that is one, now.
+// Paced, it is every tick due since the last one.
+int ticksDue(int now, int* first)
+{
+    if (!pace.limit)
+    {
+        *first = now;
+        return 1;
+    }
+    int n = (now - pace.simMs) / SIM_TICK_MS;
+    if (n < 0 || n > PACE_MAX_CATCHUP)
+    {
+        pace.simMs = now - SIM_TICK_MS;
+        n = 1;
+    }
+    *first = pace.simMs + SIM_TICK_MS;
+    pace.simMs += n * SIM_TICK_MS;
+    return n;
+}
+
+// When the tick loop should wake next, from `us`. The frame being built is
+// aimed at the vblank nearest its tick start plus the lead, and can't go out
+// before the frames still queued; the next one starts a lead before the
+// vblank after it.
+int nextTickDelayMs(double us)
+{
+    if (!pace.limit || pace.lastPresentUs <= 0.0) return SIM_TICK_MS;
+    double lead = pace.workUs + PACE_MARGIN_US;
+    double started = pace.tickStartUs > 0.0 ? pace.tickStartUs : us;
+    double k = ceil((started + lead - pace.periodUs * 0.5 - pace.lastPresentUs) / pace.periodUs);
+    k = std::max(k, (double)(pace.fences + 1));
+    double start = pace.lastPresentUs + (k + 1.0) * pace.periodUs - lead;
+    return std::max(0, (int)((start - us) / 1000.0));   // rounded down: early rather than late
+}
+
+// Pacing figures, printed every 300 frames with --gl-stats
+void reportPacing()
+{
+    if (!pace.limit || pace.frames < 300) return;
+    int n = std::max(1, pace.presents);
+    printf("pacing: %d in flight, %.2f ms between presents (period %.2f), jitter %.2f ms mean %.2f worst, "
+           "%.2f frames queued, tick to swap %.2f ms\n",
+           pace.limit, pace.intervalUs / n / 1000.0, pace.periodUs / 1000.0, pace.jitterUs / n / 1000.0,
+           pace.worstJitterUs / 1000.0, (double)pace.queued / pace.frames, pace.workUs / 1000.0);
+    pace.presents = pace.frames = pace.queued = 0;
+    pace.intervalUs = pace.jitterUs = pace.worstJitterUs = 0.0;
+}
+
+// -------------------------- Visual improvements --------------------------
+// Screens away from play only change at these steps, which is when the idle
+// loop in update() wakes to redraw them
+#define STAR_PERIOD_MS 700
+#define FIREWORK_PERIOD_MS 90
+
+// Clock for in-game pulses and the HUD timer; stands still while paused so a
+// paused screen only changes with the stars
+int sceneClockMs()
+{
+    if (state == STATE_PAUSED && g_world.pauseStartTimeMs) return g_world.pauseStartTimeMs;
+    return glutGet(GLUT_ELAPSED_TIME);
+}
+
+// Gradient background
+void drawBackground()
+{
+    cmdLayer(LAYER_BACKGROUND);
+    cmdBegin(GL_QUADS);
+    // top-left (slightly bluish)
+    cmdColor3f(0.02f, 0.03f, 0.12f);
+    cmdVertex2f(-1.0f,  1.0f);
+    // top-right
+    cmdColor3f(0.07f, 0.05f, 0.2f);
+    cmdVertex2f( 1.0f,  1.0f);
+    // bottom-right (darker)
+    cmdColor3f(0.01f, 0.01f, 0.05f);
+    cmdVertex2f( 1.0f, -1.0f);
+    // bottom-left
+    cmdColor3f(0.01f, 0.01f, 0.05f);
+    cmdVertex2f(-1.0f, -1.0f);
+    cmdEnd();
+
+    // subtle stars (random seed stable by frame)
+    int t = glutGet(GLUT_ELAPSED_TIME) / STAR_PERIOD_MS;
+    srand(t);
+    cmdPointSize(1.5f);
+    cmdBegin(GL_POINTS);
+    for (int i=0; i<quality().stars; i++)
+    {
+        float sx = (rand()%200 - 100)/100.0f;
+        float sy = (rand()%140 - 70)/100.0f;
+        float alpha = 0.4f + (rand()%60)/150.0f;
+        cmdColor4f(0.9f, 0.9f, 1.0f, alpha);
+        cmdVertex2f(sx, sy);
+    }
+    cmdEnd();
+}
+
+// Paddle with gradient/shading
+void drawPaddle(const World& w)
+{
+    cmdLayer(LAYER_PADDLE);
+    // center colors vary a bit over time for subtle liveliness
+    float t = sceneClockMs()/1000.0f;
+    float pulse = 0.05f * sinf(t*2.0f);
+    float x = latchPaddle(w), half = toF(w.paddle.width) / 2;
+    float l = x - half, r = x + half;
+
+    // top gradient
+    cmdBegin(GL_QUADS);
+    cmdColor3f(0.12f + pulse, 0.45f + pulse, 0.95f); // top-left
+    cmdVertex2f(l, -0.95f + paddleHeight);
+    cmdColor3f(0.02f + pulse, 0.25f + pulse, 0.7f);  // top-right
+    cmdVertex2f(r, -0.95f + paddleHeight);
+    cmdColor3f(0.0f, 0.12f, 0.3f);                    // bottom-right
+    cmdVertex2f(r, -0.95f);
+    cmdColor3f(0.05f, 0.2f, 0.6f);                    // bottom-left
+    cmdVertex2f(l, -0.95f);
+    cmdEnd();
+
+    // small bevel lines
+    cmdColor3f(0,0,0);
+    cmdLineWidth(1.0f);
+    cmdBegin(GL_LINE_LOOP);
+    cmdVertex2f(l, -0.95f + paddleHeight);
+    cmdVertex2f(r, -0.95f + paddleHeight);
+    cmdVertex2f(r, -0.95f);
+    cmdVertex2f(l, -0.95f);
+    cmdEnd();
+}
+
+// Ball glow (soft layered circles)
+void drawBallGlow(const World& w)
+{
+    cmdLayer(LAYER_BALL_GLOW);
+    float bx = toF(w.ball.x), by = toF(w.ball.y);
+    cmdBlend(true);
+    for (int i = 5; i >= 1; i -= quality().glowStep)
+    {
+        float a = 0.06f + 0.02f * i;
+        float r = ballRadius + 0.004f*i;
+        cmdColor4f(1.0f, 0.3f, 0.3f, a);
+        cmdBegin(GL_TRIANGLE_FAN);
+        cmdVertex2f(bx, by);
+        for (int a_deg = 0; a_deg <= 360; a_deg += quality().glowDeg)
+        {
+            float ang = a_deg * (3.1415926f / 180.0f);
+            cmdVertex2f(bx + r * cosf(ang), by + r * sinf(ang));
+        }
+        cmdEnd();
+    }
+    cmdBlend(false);
+}
+
+// Ball core
+void drawBallCore(const World& w)
+{
+    cmdLayer(LAYER_BALL);
+    float bx = toF(w.ball.x), by = toF(w.ball.y);
+    cmdColor3f(1.0f, 0.7f, 0.7f);
+    cmdBegin(GL_TRIANGLE_FAN);
+    cmdVertex2f(bx, by);
+    for (int a_deg = 0; a_deg <= 360; a_deg += 10)
+    {
+        float ang = a_deg * (3.1415926f / 180.0f);
+        cmdVertex2f(bx + ballRadius * cosf(ang), by + ballRadius * sinf(ang));
+    }
+    cmdEnd();
+}
+
+// Ball trail: draw faded circles at last positions
+void drawBallTrail(const World& w)
+{
+    cmdLayer(LAYER_TRAIL);
+    cmdBlend(true);
+    for (int i = 0; i < quality().trailLen; ++i)
+    {
+        float alpha = 0.10f * (1.0f - (float)i / TRAIL_LEN);
+        float r = ballRadius * (1.0f - 0.07f * i);
+        float tx = toF(w.ball.trailX[i]), ty = toF(w.ball.trailY[i]);
+        cmdColor4f(1.0f, 0.4f, 0.4f, alpha);
+        cmdBegin(GL_TRIANGLE_FAN);
+        cmdVertex2f(tx, ty);
+        for (int a_deg = 0; a_deg <= 360; a_deg += quality().trailDeg)
+        {
+            float ang = a_deg * (3.1415926f / 180.0f);
+            cmdVertex2f(tx + r * cosf(ang), ty + r * sinf(ang));
+        }
+        cmdEnd();
+    }
+    cmdBlend(false);
+}
+
+// Corner colours (top-left, top-right, bottom-right, bottom-left) of brick cell c
+// at row i, column j. Normal bricks keep the original row/column gradient and
+// turn bluer the more hit points they have left.
+void brickGradient(unsigned char c, int i, int j, float rgb[4][3])
+{
+    float base[4][3] =
+    {
+        { 0.9f,  0.4f - i*0.06f,  0.2f + j*0.03f },
+        { 0.7f,  0.25f - i*0.04f, 0.15f + j*0.02f },
+        { 0.5f,  0.12f - i*0.02f, 0.10f + j*0.01f },
+        { 0.65f, 0.20f - i*0.03f, 0.12f + j*0.015f },
+    };
+    float tint[3] = { 0, 0, 0 }, mix = 0.0f;
+    switch (BRICK_TYPE(c))
+    {
+    case BRICK_STEEL:
+        tint[0] = 0.62f; tint[1] = 0.65f; tint[2] = 0.7f; mix = 0.9f;
+        break;
+    case BRICK_EXPLOSIVE:
+        tint[0] = 1.0f; tint[1] = 0.85f; tint[2] = 0.1f; mix = 0.75f;
+        break;
+    case BRICK_POWERUP:
+        tint[0] = 0.25f; tint[1] = 0.9f; tint[2] = 0.4f; mix = 0.7f;
+        break;
+    default:
+        tint[0] = 0.35f; tint[1] = 0.3f; tint[2] = 0.9f;
+        mix = (BRICK_HP(c) - 1) * 0.3f;
+        if (mix > 0.9f) mix = 0.9f;
+        break;
+    }
+    for (int v = 0; v < 4; ++v)
+    {
+        float shade = 1.0f - 0.15f * (v >= 2);   // darker along the bottom edge
+        for (int k = 0; k < 3; ++k)
+            rgb[v][k] = base[v][k] + (tint[k] * shade - base[v][k]) * mix;
+    }
+}
+
+// Draw bricks - normal and fading-removed with animation
+template <class G>
+void drawBricksImpl(const World& w, const G& g)
+{
+    const BrickStore& bs = w.bricks;
+    float bw = g.brickW(), bh = g.brickH();
+    auto draw = [&](int k)
+    {
+        if (!BRICK_HP(bs.cell[k])) return;
+        int i = k / g.cols(), j = k % g.cols();
+        float x = g.colX(j), y = g.rowY(i);
+
+        // main brick body with slight vertical gradient
+        float rgb[4][3];
+        brickGradient(bs.cell[k], i, j, rgb);
+        cmdBegin(GL_QUADS);
+        cmdColor3f(rgb[0][0], rgb[0][1], rgb[0][2]);
+        cmdVertex2f(x, y);
+        cmdColor3f(rgb[1][0], rgb[1][1], rgb[1][2]);
+        cmdVertex2f(x + bw, y);
+        cmdColor3f(rgb[2][0], rgb[2][1], rgb[2][2]);
+        cmdVertex2f(x + bw, y - bh);
+        cmdColor3f(rgb[3][0], rgb[3][1], rgb[3][2]);
+        cmdVertex2f(x, y - bh);
+        cmdEnd();
+        // border
+        cmdColor3f(0.08f, 0.06f, 0.04f);
+        cmdLineWidth(1.5f);
+        cmdBegin(GL_LINE_LOOP);
+        cmdVertex2f(x, y);
+        cmdVertex2f(x + bw, y);
+        cmdVertex2f(x + bw, y - bh);
+        cmdVertex2f(x, y - bh);
+        cmdEnd();
+    };
+    int i0, i1;
+    cameraRows(bs, &i0, &i1);
+    if (i0 <= i1) g.forEachCellInRows(i0, i1, draw);
+}
+
+void drawBricks(const World& w)
+{
+    cmdLayer(LAYER_BRICKS);
+    withBoard(w.bricks, [&](const auto& g) { drawBricksImpl(w, g); });
+}
+
+// Brick fade remnants, screen flash - only the running animations
+void drawAnims(const World& w)
+{
+    cmdLayer(LAYER_ANIMS);
+    cmdBlend(true);
+    for (int k = 0; k < animCount; ++k)
+    {
+        const Anim& a = anims[k];
+        float f = a.t;
+        if (a.kind == ANIM_BRICK_FADE)
+        {
+            int i = a.row, j = a.col;
+            float x = brickX(w.bricks, j), y = brickY(w.bricks, i) - cameraY;
+            float brickWidth = w.bricks.w, brickHeight = w.bricks.h;
+            cmdColor4f(1.0f, 0.6f - i*0.05f, 0.25f + j*0.02f, f);
+            // simple expanding square fade
+            float inset = (1.0f - f) * 0.06f;
+            cmdBegin(GL_QUADS);
+            cmdVertex2f(x - inset, y + inset);
+            cmdVertex2f(x + brickWidth + inset, y + inset);
+            cmdVertex2f(x + brickWidth + inset, y - brickHeight - inset);
+            cmdVertex2f(x - inset, y - brickHeight - inset);
+            cmdEnd();
+        }
+        else if (a.kind == ANIM_FLASH)
+        {
+            float x = brickX(w.bricks, a.col), y = brickY(w.bricks, a.row) - cameraY;
+            cmdColor4f(1.0f, 1.0f, 1.0f, 0.7f * f);
+            cmdBegin(GL_QUADS);
+            cmdVertex2f(x, y);
+            cmdVertex2f(x + w.bricks.w, y);
+            cmdVertex2f(x + w.bricks.w, y - w.bricks.h);
+            cmdVertex2f(x, y - w.bricks.h);
+            cmdEnd();
+        }
+    }
+    cmdBlend(false);
+}
+
+// Power-ups draw with pulse animation
+void drawPowerUps(const World& w)
+{
+    cmdLayer(LAYER_POWERUPS);
+    const PowerUpStore& ps = w.powerUps;
+    int now = sceneClockMs();
+    for (int i = 0; i < ps.count; ++i)
+    {
+        float s = 0.02f * (1.0f + 0.15f * sinf(now/250.0f + i));
+        switch (ps.type[i])
+        {
+        case POWER_EXTRA_LIFE:
+            cmdColor3f(0.2f, 1.0f, 0.2f);
+            break;
+        case POWER_FASTER_BALL:
+            cmdColor3f(1.0f, 0.6f, 0.6f);
+            break;
+        case POWER_WIDER_PADDLE:
+            cmdColor3f(0.6f, 0.8f, 1.0f);
+            break;
+        }
+        cmdBlend(true);
+        float px = toF(ps.x[i]), py = toF(ps.y[i]);
+        cmdBegin(GL_QUADS);
+        cmdVertex2f(px - 0.03f - s, py + s);
+        cmdVertex2f(px + 0.03f + s, py + s);
+        cmdVertex2f(px + 0.03f + s, py - 0.05f - s);
+        cmdVertex2f(px - 0.03f - s, py - 0.05f - s);
+        cmdEnd();
+        cmdBlend(false);
+
+        // label
+        char label = 'L';
+        if (ps.type[i] == POWER_FASTER_BALL) label = 'F';
+        if (ps.type[i] == POWER_WIDER_PADDLE) label = 'W';
+        cmdColor3f(0,0,0);
+        char str[2] = {label, 0};
+        drawText(px - 0.01f, py - 0.03f, str);
+    }
+}
+
+// HUD drawing
+void drawHUD(const World& w)
+{
+    cmdLayer(LAYER_HUD);
+    char buffer[64];
+    sprintf(buffer, "Score: %d", w.score);
+    drawText(-0.95f, 0.93f, buffer);
+
+    sprintf(buffer, "Lives: %d", w.lives);
+    drawText(0.75f, 0.93f, buffer);
+
+    if (campaignActive())
+    {
+        sprintf(buffer, "Level %d/%d", campaign.current + 1, campaign.count);
+        drawText(0.45f, 0.93f, buffer);
+    }
+
+    int elapsedMs = 0;
+    if (state == STATE_PLAYING || state == STATE_PAUSED)
+    {
+        elapsedMs = sceneClockMs() - w.gameStartTimeMs - w.totalPausedMs;
+    }
+    int seconds = elapsedMs / 1000;
+    sprintf(buffer, "Time: %02d:%02d", seconds / 60, seconds % 60);
+    drawText(-0.1f, 0.93f, buffer);
+
+    sprintf(buffer, "GFX: %s%s %d%%", quality().name, qualityAuto ? "" : "*", (int)(renderScale() * 100.0f));
+    drawText(0.19f, 0.93f, buffer);
+
+    // -------------- MENU SCREEN --------------
+    if (state == STATE_MENU)
+    {
+        drawText(-0.25f, 0.45f, "🎮 WELCOME TO DX-BALL 🎮");
+        drawText(-0.15f, 0.25f, "Click anywhere to start");
+
+        drawText(-0.25f, 0.05f, "Controls:");
+        drawText(-0.18f, -0.05f, "• Mouse to move paddle");
+        drawText(-0.18f, -0.12f, "• A / D or Arrow Keys to move");
+        drawText(-0.18f, -0.19f, "• SPACE to launch the ball");
+        drawText(-0.18f, -0.26f, "• P to pause/resume");
+        drawText(-0.18f, -0.33f, "• Esc to exit game");
+    }
+
+    // -------------- PAUSED SCREEN --------------
+    if (state == STATE_PAUSED)
+    {
+        drawText(-0.15f, 0.1f, "⏸ GAME PAUSED ⏸");
+        drawText(-0.25f, -0.05f, "• Press P or click to resume");
+        drawText(-0.25f, -0.12f, "• Press Esc to quit to menu");
+    }
+
+    // -------------- GAME OVER SCREEN --------------
+    if (state == STATE_GAMEOVER)
+    {
+        drawText(-0.25f, 0.2f, "💀 GAME OVER 💀");
+        sprintf(buffer, "Final Score: %d", w.score);
+        drawText(-0.18f, 0.05f, buffer);
+        drawText(-0.22f, -0.1f, "• Click to restart");
+        drawText(-0.22f, -0.18f, "• Press Esc to exit");
+    }
+
+    // -------------- WIN SCREEN --------------
+    if (state == STATE_WIN)
+    {
+        drawText(-0.25f, 0.2f, "🏆 YOU WIN! 🏆");
+        sprintf(buffer, "Final Score: %d", w.score);
+        drawText(-0.18f, 0.05f, buffer);
+        drawText(-0.22f, -0.1f, hasNextLevel() ? "• Click for next level" : "• Click to play again");
+        drawText(-0.22f, -0.18f, "• Press Esc to exit");
+    }
+}
+// Fireworks (simple)
+void drawFireworks()
+{
+    if (state != STATE_WIN) return;
+    cmdLayer(LAYER_FIREWORKS);
+    cmdLineWidth(1.0f);
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    srand(now / FIREWORK_PERIOD_MS);
+    for (int k=0; k<quality().fireworks; k++)
+    {
+        float x = (rand()%200 - 100)/100.0f;
+        float y = (rand()%140 - 20)/100.0f;
+        float r = rand()%256/255.0f, g = rand()%256/255.0f, b = rand()%256/255.0f;
+        cmdColor3f(r,g,b);
+        cmdBegin(GL_LINES);
+        cmdVertex2f(x, y);
+        cmdVertex2f(x + (rand()%40 - 20)/200.0f, y + (rand()%40 - 20)/200.0f);
+        cmdEnd();
+    }
+}
+
+// -------------------------- Shader pipeline (GL 3.3) --------------------------
+// Same scene as the draw* functions above, built into one streaming VBO and drawn
+// with a single shader. Gradients come from vertex colours; the ball glow and the
+// round shapes are evaluated per pixel instead of as triangle fans. Only
+// core-profile calls are used here. Bitmap text still goes through glRasterPos,
+// so text is queued and drawn after each geometry flush. --legacy-gl selects the
+// immediate-mode path.
+#define GL3_FUNCS(X) \
+    X(PFNGLGENVERTEXARRAYSPROC, GenVertexArrays) \
+    X(PFNGLBINDVERTEXARRAYPROC, BindVertexArray) \
+    X(PFNGLGENBUFFERSPROC, GenBuffers) \
+    X(PFNGLBINDBUFFERPROC, BindBuffer) \
+    X(PFNGLBUFFERDATAPROC, BufferData) \
+    X(PFNGLBUFFERSUBDATAPROC, BufferSubData) \
+    X(PFNGLVERTEXATTRIBPOINTERPROC, VertexAttribPointer) \
+    X(PFNGLENABLEVERTEXATTRIBARRAYPROC, EnableVertexAttribArray) \
+    X(PFNGLCREATESHADERPROC, CreateShader) \
+    X(PFNGLSHADERSOURCEPROC, ShaderSource) \
+    X(PFNGLCOMPILESHADERPROC, CompileShader) \
+    X(PFNGLGETSHADERIVPROC, GetShaderiv) \
+    X(PFNGLGETSHADERINFOLOGPROC, GetShaderInfoLog) \
+    X(PFNGLDELETESHADERPROC, DeleteShader) \
+    X(PFNGLCREATEPROGRAMPROC, CreateProgram) \
+    X(PFNGLATTACHSHADERPROC, AttachShader) \
+    X(PFNGLLINKPROGRAMPROC, LinkProgram) \
+    X(PFNGLGETPROGRAMIVPROC, GetProgramiv) \
+    X(PFNGLGETPROGRAMINFOLOGPROC, GetProgramInfoLog) \
+    X(PFNGLUSEPROGRAMPROC, UseProgram) \
+    X(PFNGLGETUNIFORMLOCATIONPROC, GetUniformLocation) \
+    X(PFNGLUNIFORM2FPROC, Uniform2f)
+
+struct GL3Funcs
+{
+#define X(type, name) type name;
+    GL3_FUNCS(X)
+#undef X
+} gl3;
+
+bool useModernGL = true;
+bool glStats = false;        // --gl-stats: print CPU submit time per frame
+
+enum ShapeKind { SHAPE_FLAT = 0, SHAPE_DISC = 1, SHAPE_GLOW = 2 };
+
+struct GL3Vertex
+{
+    float x, y;
+    float r, g, b, a;
+    float lx, ly;        // offset from the shape centre (world units)
+    float kind, radius;  // ShapeKind and its radius
+};
+struct RGBA
+{
+    float r, g, b, a;
+};
+
+#define MAX_GL3_VERTS 32768
+GL3Vertex gl3Verts[MAX_GL3_VERTS];
+int gl3VertCount = 0;
+GLuint gl3Program = 0, gl3Vao = 0, gl3Vbo = 0;
+GLint gl3OffsetLoc = -1;                // uOffset, for geometry kept in its own buffer
+float gl3OffX = 0.0f, gl3OffY = 0.0f;   // screen shake and camera for gameplay geometry
+int gl3DrawCalls = 0;
+
+const char* gl3VertexSrc =
+    "#version 330 core\n"
+    "layout(location = 0) in vec2 aPos;\n"
+    "layout(location = 1) in vec4 aColor;\n"
+    "layout(location = 2) in vec2 aLocal;\n"
+    "layout(location = 3) in vec2 aShape;\n"
+    "out vec4 vColor;\n"
+    "out vec2 vLocal;\n"
+    "flat out vec2 vShape;\n"
+    "uniform vec2 uOffset;\n"
+    "void main() {\n"
+    "    vColor = aColor; vLocal = aLocal; vShape = aShape;\n"
+    "    gl_Position = vec4(aPos + uOffset, 0.0, 1.0);\n"
+    "}\n";
+
+const char* gl3FragmentSrc =
+    "#version 330 core\n"
+    "in vec4 vColor;\n"
+    "in vec2 vLocal;\n"
+    "flat in vec2 vShape;\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    vec4 c = vColor;\n"
+    "    float d = length(vLocal);\n"
+    "    float r = vShape.y;\n"
+    "    if (vShape.x > 1.5) {\n"            // glow: soft falloff past the ball edge
+    "        c.a *= 1.0 - smoothstep(r, r + 0.02, d);\n"
+    "    } else if (vShape.x > 0.5) {\n"     // disc with an antialiased rim
+    "        float aa = fwidth(d);\n"
+    "        c.a *= 1.0 - smoothstep(r - aa, r, d);\n"
+    "    }\n"
+    "    fragColor = c;\n"
+    "}\n";
+
+GLuint gl3Compile(GLenum type, const char* src)
+{
+    GLuint sh = gl3.CreateShader(type);
+    gl3.ShaderSource(sh, 1, &src, NULL);
+    gl3.CompileShader(sh);
+    GLint ok = 0;
+    gl3.GetShaderiv(sh, GL_COMPILE_STATUS, &ok);
+    if (!ok)
+    {
+        char log[512];
+        gl3.GetShaderInfoLog(sh, sizeof(log), NULL, log);
+        printf("gl3: shader compile failed: %s\n", log);
+        gl3.DeleteShader(sh);
+        return 0;
+    }
+    return sh;
+}
+
+// GL3Vertex layout for the vertex array bound now, reading the bound buffer
+void gl3Attributes()
+{
+    GLsizei stride = sizeof(GL3Vertex);
+    gl3.VertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(GL3Vertex, x));
+    gl3.VertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(GL3Vertex, r));
+    gl3.VertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(GL3Vertex, lx));
+    gl3.VertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(GL3Vertex, kind));
+    for (int i = 0; i < 4; ++i) gl3.EnableVertexAttribArray(i);
+}
+
+// Returns false (and the caller falls back to legacy) if GL 3.3 isn't there
+bool initGL3()
+{
+    const char* ver = (const char*)glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (!ver || sscanf(ver, "%d.%d", &major, &minor) != 2 || major * 10 + minor < 33)
+    {
+        printf("gl3: need OpenGL 3.3, have %s\n", ver ? ver : "?");
+        return false;
+    }
+#define X(type, name) \
+    gl3.name = (type)glutGetProcAddress("gl" #name); \
+    if (!gl3.name) { printf("gl3: missing gl" #name "\n"); return false; }
+    GL3_FUNCS(X)
+#undef X
+
+    GLuint vs = gl3Compile(GL_VERTEX_SHADER, gl3VertexSrc);
+    GLuint fs = gl3Compile(GL_FRAGMENT_SHADER, gl3FragmentSrc);
+    if (!vs || !fs) return false;
+    gl3Program = gl3.CreateProgram();
+    gl3.AttachShader(gl3Program, vs);
+    gl3.AttachShader(gl3Program, fs);
+    gl3.LinkProgram(gl3Program);
+    gl3.DeleteShader(vs);
+    gl3.DeleteShader(fs);
+    GLint ok = 0;
+    gl3.GetProgramiv(gl3Program, GL_LINK_STATUS, &ok);
+    if (!ok)
+    {
+        char log[512];
+        gl3.GetProgramInfoLog(gl3Program, sizeof(log), NULL, log);
+        printf("gl3: link failed: %s\n", log);
+        return false;
+    }
+    gl3OffsetLoc = gl3.GetUniformLocation(gl3Program, "uOffset");
+
+    gl3.GenVertexArrays(1, &gl3Vao);
+    gl3.BindVertexArray(gl3Vao);
+    gl3.GenBuffers(1, &gl3Vbo);
+    gl3.BindBuffer(GL_ARRAY_BUFFER, gl3Vbo);
+    gl3.BufferData(GL_ARRAY_BUFFER, sizeof(gl3Verts), NULL, GL_STREAM_DRAW);
+    gl3Attributes();
+    gl3.BindVertexArray(0);
+    gl3.BindBuffer(GL_ARRAY_BUFFER, 0);
+    printf("gl3: using shader pipeline (%s)\n", ver);
+    return true;
+}
+
+// Draw everything emitted so far with one call, then the text on top of it
+void gl3Flush()
+{
+    if (gl3VertCount > 0)
+    {
+        gl3.UseProgram(gl3Program);
+        gl3.BindVertexArray(gl3Vao);
+        gl3.BindBuffer(GL_ARRAY_BUFFER, gl3Vbo);
+        // orphan and refill so we never wait on the previous frame's draw
+        gl3.BufferData(GL_ARRAY_BUFFER, sizeof(gl3Verts), NULL, GL_STREAM_DRAW);
+        gl3.BufferData(GL_ARRAY_BUFFER, gl3VertCount * sizeof(GL3Vertex), gl3Verts, GL_STREAM_DRAW);
+        glDrawArrays(GL_TRIANGLES, 0, gl3VertCount);
+        gl3DrawCalls++;
+        gl3.BindVertexArray(0);
+        gl3.UseProgram(0);
+        gl3VertCount = 0;
+    }
+    if (!sceneActive) drawPendingText();
+}
+
+void gl3Vertex(float x, float y, RGBA c, float lx, float ly, ShapeKind kind, float radius)
+{
+    if (gl3VertCount >= MAX_GL3_VERTS) gl3Flush();
+    GL3Vertex& v = gl3Verts[gl3VertCount++];
+    v.x = x + gl3OffX;
+    v.y = y + gl3OffY;
+    v.r = c.r;
+    v.g = c.g;
+    v.b = c.b;
+    v.a = c.a;
+    v.lx = lx;
+    v.ly = ly;
+    v.kind = (float)kind;
+    v.radius = radius;
+}
+
+// Axis-aligned quad with a colour per corner (top-left, top-right, bottom-right, bottom-left)
+void gl3Quad(float l, float t, float r, float b, RGBA tl, RGBA tr, RGBA br, RGBA bl)
+{
+    if (gl3VertCount + 6 > MAX_GL3_VERTS) gl3Flush();
+    gl3Vertex(l, t, tl, 0, 0, SHAPE_FLAT, 0);
+    gl3Vertex(r, t, tr, 0, 0, SHAPE_FLAT, 0);
+    gl3Vertex(r, b, br, 0, 0, SHAPE_FLAT, 0);
+    gl3Vertex(l, t, tl, 0, 0, SHAPE_FLAT, 0);
+    gl3Vertex(r, b, br, 0, 0, SHAPE_FLAT, 0);
+    gl3Vertex(l, b, bl, 0, 0, SHAPE_FLAT, 0);
+}
+
+void gl3Rect(float l, float t, float r, float b, RGBA c)
+{
+    gl3Quad(l, t, r, b, c, c, c, c);
+}
+
+// Rectangle border, px pixels wide, centred on the edge like glLineWidth
+void gl3Outline(float l, float t, float r, float b, float px, RGBA c)
+{
+    float hx = px / g_viewW, hy = px / g_viewH;
+    gl3Rect(l - hx, t + hy, r + hx, t - hy, c);
+    gl3Rect(l - hx, b + hy, r + hx, b - hy, c);
+    gl3Rect(l - hx, t - hy, l + hx, b + hy, c);
+    gl3Rect(r - hx, t - hy, r + hx, b + hy, c);
+}
+
+void gl3Line(float x0, float y0, float x1, float y1, float px, RGBA c)
+{
+    float dx = (x1 - x0) * g_viewW, dy = (y1 - y0) * g_viewH;
+    float len = sqrtf(dx*dx + dy*dy);
+    if (len < 1e-4f) return;
+    float nx = -dy / len * px / g_viewW, ny = dx / len * px / g_viewH;
+    if (gl3VertCount + 6 > MAX_GL3_VERTS) gl3Flush();
+    gl3Vertex(x0 + nx, y0 + ny, c, 0, 0, SHAPE_FLAT, 0);
+    gl3Vertex(x1 + nx, y1 + ny, c, 0, 0, SHAPE_FLAT, 0);
+    gl3Vertex(x1 - nx, y1 - ny, c, 0, 0, SHAPE_FLAT, 0);
+    gl3Vertex(x0 + nx, y0 + ny, c, 0, 0, SHAPE_FLAT, 0);
+    gl3Vertex(x1 - nx, y1 - ny, c, 0, 0, SHAPE_FLAT, 0);
+    gl3Vertex(x0 - nx, y0 - ny, c, 0, 0, SHAPE_FLAT, 0);
+}
+
+// Disc or glow: a bounding quad, the shape itself is cut out in the shader
+void gl3Round(float cx, float cy, float radius, float extent, ShapeKind kind, RGBA c)
+{
+    if (gl3VertCount + 6 > MAX_GL3_VERTS) gl3Flush();
+    float e = extent;
+    gl3Vertex(cx - e, cy + e, c, -e,  e, kind, radius);
+    gl3Vertex(cx + e, cy + e, c,  e,  e, kind, radius);
+    gl3Vertex(cx + e, cy - e, c,  e, -e, kind, radius);
+    gl3Vertex(cx - e, cy + e, c, -e,  e, kind, radius);
+    gl3Vertex(cx + e, cy - e, c,  e, -e, kind, radius);
+    gl3Vertex(cx - e, cy - e, c, -e, -e, kind, radius);
+}
+
+void gl3Background()
+{
+    gl3Quad(-1.0f, 1.0f, 1.0f, -1.0f,
+            RGBA{0.02f, 0.03f, 0.12f, 1}, RGBA{0.07f, 0.05f, 0.2f, 1},
+            RGBA{0.01f, 0.01f, 0.05f, 1}, RGBA{0.01f, 0.01f, 0.05f, 1});
+
+    // same star pattern as drawBackground
+    int t = glutGet(GLUT_ELAPSED_TIME) / STAR_PERIOD_MS;
+    srand(t);
+    float hx = 0.75f / g_viewW * 2.0f, hy = 0.75f / g_viewH * 2.0f;
+    for (int i=0; i<quality().stars; i++)
+    {
+        float sx = (rand()%200 - 100)/100.0f;
+        float sy = (rand()%140 - 70)/100.0f;
+        float alpha = 0.4f + (rand()%60)/150.0f;
+        gl3Rect(sx - hx, sy + hy, sx + hx, sy - hy, RGBA{0.9f, 0.9f, 1.0f, alpha});
+    }
+}
+
+// One brick: the body, then its border (GL3_BRICK_VERTS vertices)
+#define GL3_BRICK_VERTS 30
+template <class G>
+void gl3Brick(const G& g, unsigned char c, int k)
+{
+    int i = k / g.cols(), j = k % g.cols();
+    float x = g.colX(j), y = g.rowY(i), bw = g.brickW(), bh = g.brickH();
+    float rgb[4][3];
+    brickGradient(c, i, j, rgb);
+    gl3Quad(x, y, x + bw, y - bh,
+            RGBA{rgb[0][0], rgb[0][1], rgb[0][2], 1},
+            RGBA{rgb[1][0], rgb[1][1], rgb[1][2], 1},
+            RGBA{rgb[2][0], rgb[2][1], rgb[2][2], 1},
+            RGBA{rgb[3][0], rgb[3][1], rgb[3][2], 1});
+    gl3Outline(x, y, x + bw, y - bh, 1.5f, RGBA{0.08f, 0.06f, 0.04f, 1});
+}
+
+// Streamed: every live brick in the visible rows, each frame
+template <class G>
+void gl3BricksImpl(const World& w, const G& g)
+{
+    const BrickStore& bs = w.bricks;
+    auto emit = [&](int k)
+    {
+        if (BRICK_HP(bs.cell[k])) gl3Brick(g, bs.cell[k], k);
+    };
+    int i0, i1;
+    cameraRows(bs, &i0, &i1);
+    if (i0 <= i1) g.forEachCellInRows(i0, i1, emit);
+}
+
+// -------------------------- Brick buffer (GL 3.3) --------------------------
+// Bricks change a few cells at a time, so the shader path keeps them in a
+// buffer of their own instead of streaming them every frame. Every cell has a
+// fixed slot of GL3_BRICK_VERTS vertices in board order (empty cells are
+// degenerate), so the visible rows are one contiguous draw and a change is one
+// BufferSubData of its slot. The buffer follows the board through its brick
+// journal; a new board, a wrapped journal or a new view size (the borders are
+// sized in pixels) writes it all again. Screen shake and the camera come in
+// through uOffset. Bigger boards than GL3_BRICK_CACHE_CELLS stream as before.
+#define GL3_BRICK_CACHE_CELLS 4096
+#define GL3_BRICK_CHUNK_CELLS 1024      // cells written per upload when rebuilding
+
+struct GL3BrickCache
+{
+    GLuint vao, vbo;
+    BrickCursor cursor;
+    int cells;              // slots in the buffer
+    int viewW, viewH;
+    int patched, rebuilt;   // for --gl-stats
+} gl3BrickCache;
+
+// Write cell k's slot at the end of gl3Verts
+template <class G>
+void gl3BrickSlot(const G& g, const BrickStore& bs, int k)
+{
+    if (BRICK_HP(bs.cell[k])) gl3Brick(g, bs.cell[k], k);
+    else
+    {
+        memset(&gl3Verts[gl3VertCount], 0, GL3_BRICK_VERTS * sizeof(GL3Vertex));
+        gl3VertCount += GL3_BRICK_VERTS;
+    }
+}
+
+template <class G>
+void gl3UpdateBrickCache(const World& w, const G& g)
+{
+    GL3BrickCache& c = gl3BrickCache;
+    const BrickStore& bs = w.bricks;
+    int n = bs.rows * bs.cols;
+    const size_t slot = GL3_BRICK_VERTS * sizeof(GL3Vertex);
+    gl3.BindBuffer(GL_ARRAY_BUFFER, c.vbo);
+
+    auto patch = [&](const BrickChange& e)
+    {
+        gl3VertCount = 0;
+        gl3BrickSlot(g, bs, e.cell);
+        gl3.BufferSubData(GL_ARRAY_BUFFER, e.cell * slot, slot, gl3Verts);
+        c.patched++;
+    };
+    bool current = readJournal(w, c.cursor, patch) && c.cells == n &&
+                   c.viewW == g_viewW && c.viewH == g_viewH;
+    if (!current)
+    {
+        gl3.BufferData(GL_ARRAY_BUFFER, n * slot, NULL, GL_STATIC_DRAW);
+        for (int k0 = 0; k0 < n; k0 += GL3_BRICK_CHUNK_CELLS)
+        {
+            int k1 = std::min(n, k0 + GL3_BRICK_CHUNK_CELLS);
+            gl3VertCount = 0;
+            for (int k = k0; k < k1; ++k) gl3BrickSlot(g, bs, k);
+            gl3.BufferSubData(GL_ARRAY_BUFFER, k0 * slot, (k1 - k0) * slot, gl3Verts);
+        }
+        c.cells = n;
+        c.viewW = g_viewW;
+        c.viewH = g_viewH;
+        c.rebuilt++;
+    }
+    gl3VertCount = 0;
+    gl3.BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+template <class G>
+void gl3CachedBricksImpl(const World& w, const G& g)
+{
+    GL3BrickCache& c = gl3BrickCache;
+    if (!c.vao)
+    {
+        gl3.GenVertexArrays(1, &c.vao);
+        gl3.BindVertexArray(c.vao);
+        gl3.GenBuffers(1, &c.vbo);
+        gl3.BindBuffer(GL_ARRAY_BUFFER, c.vbo);
+        gl3Attributes();
+        gl3.BindVertexArray(0);
+    }
+    gl3Flush();     // what is under the bricks; gl3Verts is scratch from here
+    float offX = gl3OffX, offY = gl3OffY;
+    gl3OffX = gl3OffY = 0.0f;
+    gl3UpdateBrickCache(w, g);
+    gl3OffX = offX;
+    gl3OffY = offY;
+
+    int i0, i1;
+    cameraRows(w.bricks, &i0, &i1);
+    if (i0 > i1) return;
+    gl3.UseProgram(gl3Program);
+    gl3.Uniform2f(gl3OffsetLoc, gl3OffX, gl3OffY);
+    gl3.BindVertexArray(c.vao);
+    glDrawArrays(GL_TRIANGLES, i0 * g.cols() * GL3_BRICK_VERTS, (i1 - i0 + 1) * g.cols() * GL3_BRICK_VERTS);
+    gl3DrawCalls++;
+    gl3.BindVertexArray(0);
+    gl3.Uniform2f(gl3OffsetLoc, 0.0f, 0.0f);
+    gl3.UseProgram(0);
+}
+
+void gl3Bricks(const World& w)
+{
+    if (w.bricks.rows * w.bricks.cols <= GL3_BRICK_CACHE_CELLS)
+        withBoard(w.bricks, [&](const auto& g) { gl3CachedBricksImpl(w, g); });
+    else
+        withBoard(w.bricks, [&](const auto& g) { gl3BricksImpl(w, g); });
+}
+
+void gl3BallTrail(const World& w)
+{
+    for (int i = 0; i < quality().trailLen; ++i)
+    {
+        float alpha = 0.10f * (1.0f - (float)i / TRAIL_LEN);
+        float r = ballRadius * (1.0f - 0.07f * i);
+        gl3Round(toF(w.ball.trailX[i]), toF(w.ball.trailY[i]), r, r * 1.1f, SHAPE_DISC, RGBA{1.0f, 0.4f, 0.4f, alpha});
+    }
+}
+
+void gl3Paddle(const World& w)
+{
+    float t = sceneClockMs()/1000.0f;
+    float pulse = 0.05f * sinf(t*2.0f);
+    float x = latchPaddle(w), half = toF(w.paddle.width) / 2;
+    float l = x - half, r = x + half;
+    float top = -0.95f + paddleHeight, bottom = -0.95f;
+    gl3Quad(l, top, r, bottom,
+            RGBA{0.12f + pulse, 0.45f + pulse, 0.95f, 1},
+            RGBA{0.02f + pulse, 0.25f + pulse, 0.7f, 1},
+            RGBA{0.0f, 0.12f, 0.3f, 1},
+            RGBA{0.05f, 0.2f, 0.6f, 1});
+    gl3Outline(l, top, r, bottom, 1.0f, RGBA{0, 0, 0, 1});
+}
+
+void gl3Ball(const World& w)
+{
+    // the five stacked glow layers of drawBallGlow composite to ~0.47 alpha
+    float ext = ballRadius + 0.03f;
+    float bx = toF(w.ball.x), by = toF(w.ball.y);
+    gl3Round(bx, by, ballRadius, ext, SHAPE_GLOW, RGBA{1.0f, 0.3f, 0.3f, 0.47f});
+    gl3Round(bx, by, ballRadius, ballRadius * 1.1f, SHAPE_DISC, RGBA{1.0f, 0.7f, 0.7f, 1});
+}
+
+void gl3PowerUps(const World& w)
+{
+    const PowerUpStore& ps = w.powerUps;
+    int now = sceneClockMs();
+    for (int i = 0; i < ps.count; ++i)
+    {
+        float s = 0.02f * (1.0f + 0.15f * sinf(now/250.0f + i));
+        RGBA c = {0.2f, 1.0f, 0.2f, 1};
+        const char* label = "L";
+        if (ps.type[i] == POWER_FASTER_BALL)
+        {
+            c = RGBA{1.0f, 0.6f, 0.6f, 1};
+            label = "F";
+        }
+        else if (ps.type[i] == POWER_WIDER_PADDLE)
+        {
+            c = RGBA{0.6f, 0.8f, 1.0f, 1};
+            label = "W";
+        }
+        float px = toF(ps.x[i]), py = toF(ps.y[i]);
+        gl3Rect(px - 0.03f - s, py + s, px + 0.03f + s, py - 0.05f - s, c);
+        glColor3f(0,0,0);
+        drawText(px - 0.01f + gl3OffX, py - 0.03f + gl3OffY, label);
+    }
+}
+
+void gl3Anims(const World& w)
+{
+    for (int k = 0; k < animCount; ++k)
+    {
+        const Anim& a = anims[k];
+        float f = a.t;
+        if (a.kind == ANIM_BRICK_FADE)
+        {
+            int i = a.row, j = a.col;
+            float x = brickX(w.bricks, j), y = brickY(w.bricks, i) - cameraY;
+            float inset = (1.0f - f) * 0.06f;
+            gl3Rect(x - inset, y + inset, x + w.bricks.w + inset, y - w.bricks.h - inset,
+                    RGBA{1.0f, 0.6f - i*0.05f, 0.25f + j*0.02f, f});
+        }
+        else if (a.kind == ANIM_FLASH)
+        {
+            float x = brickX(w.bricks, a.col), y = brickY(w.bricks, a.row) - cameraY;
+            gl3Rect(x, y, x + w.bricks.w, y - w.bricks.h, RGBA{1.0f, 1.0f, 1.0f, 0.7f * f});
+        }
+    }
+}
+
+void gl3Fireworks()
+{
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    srand(now / FIREWORK_PERIOD_MS);
+    for (int k=0; k<quality().fireworks; k++)
+    {
+        float x = (rand()%200 - 100)/100.0f;
+        float y = (rand()%140 - 20)/100.0f;
+        float r = rand()%256/255.0f, g = rand()%256/255.0f, b = rand()%256/255.0f;
+        float x1 = x + (rand()%40 - 20)/200.0f;
+        float y1 = y + (rand()%40 - 20)/200.0f;
+        gl3Line(x, y, x1, y1, 0.5f, RGBA{r, g, b, 1});
+    }
+}
+
+// -------------------------- Retained UI --------------------------
+// Each overlay screen is a list of widgets built once at startup. The fills and
+// borders of a screen are cached as one triangle list (rebuilt when the window
+// size changes, since borders are in pixels) and go out as a single batch in
+// either render path; only the text is walked per frame. Buttons are found
+// through a coarse grid of bitmasks and carry a UiAction, which is also what
+// the keyboard shortcuts dispatch.
+enum UiAction
+{
+    UI_NONE, UI_START_GAME, UI_SHOW_INSTRUCTIONS, UI_SHOW_MENU,
+    UI_RESUME, UI_RESTART, UI_CONTINUE, UI_QUIT
+};
+
+enum WidgetKind { WIDGET_DIM, WIDGET_PANEL, WIDGET_BUTTON, WIDGET_TEXT };
+
+// Text that changes while the screen is up
+enum UiTextSource { UI_TEXT_FIXED, UI_TEXT_FINAL_SCORE, UI_TEXT_WIN_HINT, UI_TEXT_TOP_TITLE, UI_TEXT_TOP_SCORE };
+
+struct Widget
+{
+    WidgetKind kind;
+    float left, top, right, bottom;     // text: left/top is the baseline start
+    RGBA color;
+    RGBA border;
+    float borderPx;                     // 0 = no border
+    const char* text;                   // button label or fixed text
+    UiTextSource source;
+    int index;                          // leaderboard slot for UI_TEXT_TOP_SCORE
+    float labelShift;                   // label start left of the button centre
+    UiAction action;
+};
+
+#define MAX_WIDGETS 16
+#define UI_GRID 8   // hit-test cells per axis over NDC
+
+typedef unsigned int UiMask;            // one bit per widget slot
+static_assert(MAX_WIDGETS <= sizeof(UiMask) * 8, "hit grid mask is narrower than MAX_WIDGETS");
+
+struct UiScreen
+{
+    Widget widgets[MAX_WIDGETS];
+    int count;
+    UiAction clickAction;               // clicks that miss every button
+    std::vector<CmdVertex> verts;       // cached fills and borders
+    UiMask grid[UI_GRID][UI_GRID];      // bit k = widget k may be under the cell
+};
+
+UiScreen uiScreens[STATE_WIN + 1];      // indexed by GameState; playing has none
+
+// Screens are laid out once at start-up, so running out of slots is a layout
+// bug and stops the game rather than writing past the array
+Widget& uiAdd(UiScreen& s, WidgetKind kind, float l, float t, float r, float b, RGBA c)
+{
+    if (s.count >= MAX_WIDGETS)
+    {
+        printf("ui: more than %d widgets on one screen\n", MAX_WIDGETS);
+        abort();
+    }
+    Widget& wd = s.widgets[s.count++];
+    wd.kind = kind;
+    wd.left = l;
+    wd.top = t;
+    wd.right = r;
+    wd.bottom = b;
+    wd.color = c;
+    wd.border = RGBA{0, 0, 0, 0};
+    wd.borderPx = 0.0f;
+    wd.text = NULL;
+    wd.source = UI_TEXT_FIXED;
+    wd.index = 0;
+    wd.labelShift = 0.0f;
+    wd.action = UI_NONE;
+    return wd;
+}
+
+Widget& uiPanel(UiScreen& s, float w, float h, RGBA c)
+{
+    return uiAdd(s, WIDGET_PANEL, -w/2, h/2, w/2, -h/2, c);
+}
+
+Widget& uiText(UiScreen& s, float x, float y, RGBA c, const char* text, UiTextSource source = UI_TEXT_FIXED)
+{
+    Widget& wd = uiAdd(s, WIDGET_TEXT, x, y, x, y, c);
+    wd.text = text;
+    wd.source = source;
+    return wd;
+}
+
+void uiButton(UiScreen& s, float l, float t, float r, float b, const char* label, float labelShift, UiAction a)
+{
+    Widget& wd = uiAdd(s, WIDGET_BUTTON, l, t, r, b, RGBA{0.18f, 0.18f, 0.22f, 1});
+    wd.border = RGBA{0.9f, 0.9f, 0.9f, 1};
+    wd.borderPx = 1.0f;
+    wd.text = label;
+    wd.labelShift = labelShift;
+    wd.action = a;
+}
+
+void uiQuad(std::vector<CmdVertex>& v, float l, float t, float r, float b, RGBA c)
+{
+    CmdVertex tl = { l, t, c.r, c.g, c.b, c.a }, tr = { r, t, c.r, c.g, c.b, c.a };
+    CmdVertex br = { r, b, c.r, c.g, c.b, c.a }, bl = { l, b, c.r, c.g, c.b, c.a };
+    v.push_back(tl);
+    v.push_back(tr);
+    v.push_back(br);
+    v.push_back(tl);
+    v.push_back(br);
+    v.push_back(bl);
+}
+
+// Geometry cache and hit grid for the current window size
+void uiBuild(UiScreen& s)
+{
+    s.verts.clear();
+    memset(s.grid, 0, sizeof(s.grid));
+    for (int k = 0; k < s.count; ++k)
+    {
+        const Widget& wd = s.widgets[k];
+        if (wd.kind == WIDGET_TEXT) continue;
+        if (wd.kind == WIDGET_DIM) uiQuad(s.verts, -1, 1, 1, -1, wd.color);
+        else uiQuad(s.verts, wd.left, wd.top, wd.right, wd.bottom, wd.color);
+        if (wd.borderPx > 0.0f)
+        {
+            float hx = wd.borderPx / g_winW, hy = wd.borderPx / g_winH;
+            float l = wd.left, t = wd.top, r = wd.right, b = wd.bottom;
+            uiQuad(s.verts, l - hx, t + hy, r + hx, t - hy, wd.border);
+            uiQuad(s.verts, l - hx, b + hy, r + hx, b - hy, wd.border);
+            uiQuad(s.verts, l - hx, t - hy, l + hx, b + hy, wd.border);
+            uiQuad(s.verts, r - hx, t - hy, r + hx, b + hy, wd.border);
+        }
+        if (wd.kind != WIDGET_BUTTON) continue;
+        int c0 = (int)((wd.left + 1.0f) * 0.5f * UI_GRID), c1 = (int)((wd.right + 1.0f) * 0.5f * UI_GRID);
+        int r0 = (int)((1.0f - wd.top) * 0.5f * UI_GRID), r1 = (int)((1.0f - wd.bottom) * 0.5f * UI_GRID);
+        for (int gy = r0 < 0 ? 0 : r0; gy <= r1 && gy < UI_GRID; ++gy)
+            for (int gx = c0 < 0 ? 0 : c0; gx <= c1 && gx < UI_GRID; ++gx)
+                s.grid[gy][gx] |= (UiMask)1 << k;
+    }
+}
+
+void uiLayout()
+{
+    for (int i = 0; i <= STATE_WIN; ++i) uiBuild(uiScreens[i]);
+}
+
+void initUi()
+{
+    const RGBA white = {1, 1, 1, 1}, dimGrey = {0.8f, 0.8f, 0.8f, 1};
+    const RGBA red = {1.0f, 0.2f, 0.2f, 1}, yellow = {1, 1, 0.2f, 1};
+    UiScreen* s;
+
+    s = &uiScreens[STATE_MENU];
+    uiAdd(*s, WIDGET_DIM, -1, 1, 1, -1, RGBA{0, 0, 0, 0.6f});
+    uiPanel(*s, 0.7f, 0.6f, RGBA{0.1f, 0.1f, 0.15f, 1});
+    uiText(*s, -0.20f, 0.22f, white, "DX-Ball OpenGL");
+    uiButton(*s, -0.25f, 0.10f, 0.25f, 0.00f, "Start Game", 0.09f, UI_START_GAME);
+    uiButton(*s, -0.25f, -0.05f, 0.25f, -0.15f, "Instructions", 0.09f, UI_SHOW_INSTRUCTIONS);
+    uiButton(*s, -0.25f, -0.20f, 0.25f, -0.30f, "Quit", 0.09f, UI_QUIT);
+    // leaderboard from the score log, right of the panel
+    uiText(*s, 0.45f, 0.22f, white, NULL, UI_TEXT_TOP_TITLE);
+    for (int k = 0; k < SCORE_TOP_N; ++k)
+        uiText(*s, 0.45f, 0.14f - 0.07f * k, dimGrey, NULL, UI_TEXT_TOP_SCORE).index = k;
+
+    s = &uiScreens[STATE_INSTRUCTIONS];
+    s->clickAction = UI_SHOW_MENU;
+    uiAdd(*s, WIDGET_DIM, -1, 1, 1, -1, RGBA{0, 0, 0, 0.7f});
+    uiPanel(*s, 0.7f, 0.6f, RGBA{0.1f, 0.1f, 0.15f, 1});
+    uiText(*s, -0.12f, 0.22f, white, "Instructions");
+    uiText(*s, -0.25f, 0.12f, white, "• Mouse to move paddle");
+    uiText(*s, -0.25f, 0.05f, white, "• A / D or Arrow Keys to move");
+    uiText(*s, -0.25f, -0.02f, white, "• SPACE to launch the ball");
+    uiText(*s, -0.25f, -0.09f, white, "• P to pause/resume");
+    uiText(*s, -0.25f, -0.16f, white, "• Esc to exit game");
+    uiText(*s, -0.25f, -0.28f, white, "Click anywhere to return to menu");
+
+    // pause buttons stack down from a centre line
+    float bW = 0.30f, bH = 0.10f, cy = 0.05f;
+    s = &uiScreens[STATE_PAUSED];
+    uiAdd(*s, WIDGET_DIM, -1, 1, 1, -1, RGBA{0, 0, 0, 0.6f});
+    uiPanel(*s, 0.6f, 0.5f, RGBA{0.08f, 0.08f, 0.12f, 1});
+    uiText(*s, -0.12f, 0.18f, white, "Game Paused");
+    uiButton(*s, -bW/2, cy + bH/2, bW/2, cy - bH/2, "Resume", 0.10f, UI_RESUME);
+    uiButton(*s, -bW/2, cy - bH/2 - 0.05f, bW/2, cy - bH/2 - 0.15f, "Restart", 0.10f, UI_RESTART);
+    uiButton(*s, -bW/2, cy - bH/2 - 0.25f, bW/2, cy - bH/2 - 0.35f, "Quit", 0.10f, UI_QUIT);
+
+    s = &uiScreens[STATE_GAMEOVER];
+    s->clickAction = UI_RESTART;
+    uiAdd(*s, WIDGET_DIM, -1, 1, 1, -1, RGBA{0, 0, 0, 0.6f});
+    Widget& panel = uiPanel(*s, 0.75f, 0.6f, RGBA{0.1f, 0.1f, 0.15f, 1});
+    panel.border = red;
+    panel.borderPx = 3.0f;
+    uiText(*s, -0.18f, 0.2f, red, "💀 GAME OVER 💀");
+    uiText(*s, -0.12f, 0.08f, white, NULL, UI_TEXT_FINAL_SCORE);
+    uiText(*s, -0.25f, -0.08f, dimGrey, "Click LEFT MOUSE to RESTART");
+    uiText(*s, -0.15f, -0.18f, dimGrey, "Press ESC to QUIT");
+
+    s = &uiScreens[STATE_WIN];
+    s->clickAction = UI_CONTINUE;
+    uiAdd(*s, WIDGET_DIM, -1, 1, 1, -1, RGBA{0, 0, 0, 0.6f});
+    uiPanel(*s, 0.6f, 0.5f, RGBA{0.1f, 0.1f, 0.15f, 1});
+    uiText(*s, -0.18f, 0.15f, yellow, "🏆 YOU WIN! 🏆");
+    uiText(*s, -0.15f, 0.05f, yellow, NULL, UI_TEXT_FINAL_SCORE);
+    uiText(*s, -0.22f, -0.1f, yellow, NULL, UI_TEXT_WIN_HINT);
+    uiText(*s, -0.22f, -0.18f, yellow, "Press ESC to exit");
+
+    uiLayout();
+}
+
+// Action under an NDC point on the current screen
+UiAction uiHitTest(GameState st, float nx, float ny)
+{
+    const UiScreen& s = uiScreens[st];
+    int gx = (int)((nx + 1.0f) * 0.5f * UI_GRID), gy = (int)((1.0f - ny) * 0.5f * UI_GRID);
+    if (gx >= 0 && gy >= 0 && gx < UI_GRID && gy < UI_GRID)
+        for (UiMask mask = s.grid[gy][gx]; mask; mask &= mask - 1)
+        {
+            const Widget& wd = s.widgets[__builtin_ctz(mask)];
+            if (nx >= wd.left && nx <= wd.right && ny <= wd.top && ny >= wd.bottom)
+                return wd.action;
+        }
+    return s.clickAction;
+}
+
+void uiTextColor(const RGBA& c)
+{
+    if (cmdRecording) cmdColor4f(c.r, c.g, c.b, c.a);
+    else glColor4f(c.r, c.g, c.b, c.a);
+}
+
+// The current screen: cached geometry as one batch, then its text
+void drawUi(const World& w)
+{
+    const UiScreen& s = uiScreens[state];
+    if (s.verts.empty()) return;
+    if (cmdRecording)
+    {
+        cmdLayer(LAYER_DIM);
+        cmdBlend(true);
+        cmdTriangles(s.verts.data(), (int)s.verts.size());
+        cmdBlend(false);
+        cmdLayer(LAYER_PANEL);
+    }
+    else
+    {
+        if (gl3VertCount + (int)s.verts.size() > MAX_GL3_VERTS) gl3Flush();
+        for (size_t i = 0; i < s.verts.size(); ++i)
+        {
+            const CmdVertex& v = s.verts[i];
+            gl3Vertex(v.x, v.y, RGBA{v.r, v.g, v.b, v.a}, 0.0f, 0.0f, SHAPE_FLAT, 0.0f);
+        }
+    }
+
+    char buffer[48];
+    for (int k = 0; k < s.count; ++k)
+    {
+        const Widget& wd = s.widgets[k];
+        if (wd.kind == WIDGET_BUTTON)
+        {
+            uiTextColor(wd.border);
+            drawText((wd.left + wd.right) * 0.5f - wd.labelShift, (wd.top + wd.bottom) * 0.5f - 0.02f, wd.text);
+        }
+        if (wd.kind != WIDGET_TEXT) continue;
+        const char* text = wd.text;
+        if (wd.source == UI_TEXT_FINAL_SCORE)
+        {
+            sprintf(buffer, "Final Score: %d", w.score);
+            text = buffer;
+        }
+        else if (wd.source == UI_TEXT_WIN_HINT)
+            text = hasNextLevel() ? "Click LEFT MOUSE for next level" : "Click LEFT MOUSE to play again";
+        else if (wd.source == UI_TEXT_TOP_TITLE)
+            text = scoresEnabled && g_scores.top[0].score >= 0 ? "High Scores" : NULL;
+        else if (wd.source == UI_TEXT_TOP_SCORE)
+        {
+            if (!scoresEnabled || g_scores.top[wd.index].score < 0) continue;
+            sprintf(buffer, "%d.  %d", wd.index + 1, g_scores.top[wd.index].score);
+            text = buffer;
+        }
+        if (!text) continue;
+        uiTextColor(wd.color);
+        drawText(wd.left, wd.top, text);
+    }
+}
+
+// field is the game drawn in the playfield, if any; w feeds the HUD and overlays
+void displayGL3(const World& w, const World* field)
+{
+    deferText = true;
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    gl3Background();
+    if (field)
+    {
+        animShakeOffset(&gl3OffX, &gl3OffY);
+        gl3OffY -= cameraY;
+        gl3Bricks(*field);
+        gl3BallTrail(*field);
+        gl3Paddle(*field);
+        gl3Ball(*field);
+        gl3PowerUps(*field);
+        gl3OffX = gl3OffY = 0.0f;
+        gl3Anims(*field);
+    }
+    if (sceneActive)
+    {
+        gl3Flush();
+        endScene();
+    }
+    glColor3f(1, 1, 1);
+    drawHUD(w);
+    gl3Flush();
+
+    drawUi(w);
+    if (state == STATE_WIN) gl3Fireworks();
+    gl3Flush();
+    deferText = false;
+}
+
+// Average CPU time spent issuing GL calls, printed every 300 frames
+void reportSubmitTime(double startUs)
+{
+    static double sumUs = 0.0;
+    static int frames = 0, drawCalls = 0, stateChanges = 0, recDraws = 0, recChanges = 0;
+    static int bricksPatched = 0, brickRebuilds = 0;
+    sumUs += nowUs() - startUs;
+    drawCalls += useModernGL ? gl3DrawCalls : cmdDrawCalls;
+    stateChanges += cmdStateChanges;
+    recDraws += cmdRecordedDraws;
+    recChanges += cmdRecordedChanges;
+    gl3DrawCalls = 0;
+    bricksPatched += gl3BrickCache.patched;
+    brickRebuilds += gl3BrickCache.rebuilt;
+    gl3BrickCache.patched = gl3BrickCache.rebuilt = 0;
+    if (++frames < 300) return;
+    if (useModernGL)
+        printf("render: gl3, %.3f ms CPU submit per frame, %.1f draw calls, "
+               "%d bricks patched and %d brick buffer rebuilds\n",
+               sumUs / frames / 1000.0, (float)drawCalls / frames, bricksPatched, brickRebuilds);
+    else
+        printf("render: legacy, %.3f ms CPU submit per frame, %.1f draw calls (%.1f recorded), "
+               "%.1f state changes (%.1f recorded)\n",
+               sumUs / frames / 1000.0, (float)drawCalls / frames, (float)recDraws / frames,
+               (float)stateChanges / frames, (float)recChanges / frames);
+    sumUs = 0.0;
+    frames = drawCalls = stateChanges = recDraws = recChanges = 0;
+    bricksPatched = brickRebuilds = 0;
+}
+
+// Frame tail for both paths: stats, quality and scale feedback, swap
+void endFrame(double startUs)
+{
+    endScene();
+    gpuTimerEnd();
+    if (glStats) reportSubmitTime(startUs);
+    if (qualityAuto || renderScaleAuto)
+        updateQuality((nowUs() - startUs) / 1000.0 + gpuFrameMs());
+    histRecord(H_FRAME_US, (unsigned int)(nowUs() - startUs));
+    countMetric(M_FRAMES);
+    glutSwapBuffers();
+    paceFrame();
+    if (glStats) reportPacing();
+}
+
+// The game in the playfield: the player's while playing or paused, the demo
+// behind the menu, or none
+const World* playfieldWorld()
+{
+    if (state == STATE_PLAYING || state == STATE_PAUSED) return &g_world;
+    if (state == STATE_MENU && attractMode && attractLive) return &g_attract;
+    return NULL;
+}
+
+// The legacy path's whole frame, into the command buffer
+void recordFrame(const World& w, const World* field)
+{
+    cmdReset();
+    drawBackground();
+
+    if (field)
+    {
+        animShakeOffset(&cmdOffX, &cmdOffY);
+        cmdOffY -= cameraY;
+        drawBricks(*field);
+        drawBallTrail(*field);
+        drawPaddle(*field);
+        drawBallGlow(*field);
+        drawBallCore(*field);
+        drawPowerUps(*field);
+        cmdOffX = cmdOffY = 0.0f;
+        drawAnims(*field);
+    }
+
+    // HUD always on top
+    cmdColor3f(1, 1, 1);
+    drawHUD(w);
+
+    // overlay depending on state
+    drawUi(w);
+
+    // fireworks only for WIN
+    if (state == STATE_WIN) drawFireworks();
+}
+
+// Frames of warm-up; after them the tick and the draw must not allocate
+#define ALLOC_WARMUP_FRAMES 120
+
+void display()
+{
+    AllocScope scope(PHASE_DRAW);
+    static int framesDrawn = 0;
+    if (++framesDrawn == ALLOC_WARMUP_FRAMES) allocArm();
+    const World& w = g_world;
+    const World* field = playfieldWorld();
+    double submitStartUs = nowUs();
+    gpuTimerBegin();
+    beginScene();
+    if (field) updateCamera(*field);
+
+    if (useModernGL)
+    {
+        displayGL3(w, field);
+        endFrame(submitStartUs);
+        return;
+    }
+
+    cmdRecording = deferText = true;
+    recordFrame(w, field);
+    cmdFlush();
+    cmdRecording = deferText = false;
+
+    endFrame(submitStartUs);
+}
+
+// -------------------------- Systems --------------------------
+// Each system walks one or two component stores in order. None of them touch GL
+// or GLUT, so a World can be stepped headless.
+
+void spawnPowerUp(World& w, real x, real y, PowerType t, bool inChain = false)
+{
+    PowerUpStore& ps = w.powerUps;
+    if (ps.count >= MAX_POWERUPS) return;
+    int i = ps.count++;
+    ps.type[i] = t;
+    ps.x[i] = x;
+    ps.y[i] = y;
+    ps.vy[i] = -0.008f - (worldRand(w)%8)/1000.0f;
+    if (!inChain) pushEvent(w, EV_POWERUP_SPAWNED, t, 0);
+}
+
+void removePowerUp(PowerUpStore& ps, int i)
+{
+    int last = --ps.count;
+    ps.x[i] = ps.x[last];
+    ps.y[i] = ps.y[last];
+    ps.vy[i] = ps.vy[last];
+    ps.type[i] = ps.type[last];
+}
+
+// Trail runs every tick, even before launch
+void sysTrail(World& w)
+{
+    Ball& b = w.ball;
+    // Update trail buffer
+    for (int i = TRAIL_LEN - 1; i > 0; --i)
+    {
+        b.trailX[i] = b.trailX[i - 1];
+        b.trailY[i] = b.trailY[i - 1];
+    }
+    b.trailX[0] = b.x;
+    b.trailY[0] = b.y;
+}
+
+// Move ball and bounce off walls and paddle
+void sysMovement(World& w)
+{
+    Ball& b = w.ball;
+    const Paddle& p = w.paddle;
+
+    b.x += b.dx * b.speedMul;
+    b.y += b.dy * b.speedMul;
+
+    // Wall collisions
+    if (b.x + ballRadius > 1.0f)
+    {
+        b.x = 1.0f - ballRadius;
+        b.dx = -physAbs(b.dx);
+    }
+    if (b.x - ballRadius < -1.0f)
+    {
+        b.x = -1.0f + ballRadius;
+        b.dx = physAbs(b.dx);
+    }
+    if (b.y + ballRadius > w.bricks.ceilY)
+    {
+        b.y = w.bricks.ceilY - ballRadius;
+        b.dy = -physAbs(b.dy);
+    }
+
+    // Paddle collision
+    if (b.y - ballRadius <= -0.95f + paddleHeight &&
+            b.y - ballRadius >= -0.95f - 0.02f &&
+            b.x >= p.x - p.width/2 - 0.02f &&
+            b.x <= p.x + p.width/2 + 0.02f &&
+            b.dy < 0.05f)
+    {
+        real hitPos = (b.x - p.x) / (p.width / 2);
+        real angle = hitPos * (3.14159f / 3.5f);  // wider angle control
+        real speed = physSqrt(b.dx * b.dx + b.dy * b.dy);
+        b.dx = speed * physSin(angle);
+        b.dy = physAbs(speed * physCos(angle));
+        if (b.dy < 0) b.dy = -b.dy;
+        pushEvent(w, EV_PADDLE_HIT, 0, 0);
+    }
+}
+
+// Remove a breakable brick. Power-ups drop at (px, py): always from power-up
+// bricks, one time in four from the rest. Explosives are left marked for
+// resolveBlast instead of cleared. Bricks taken by a chain, and what they
+// drop, get no events of their own; resolveBlast counts them instead.
+void destroyBrick(World& w, int i, int j, real px, real py, bool inChain = false)
+{
+    BrickStore& bs = w.bricks;
+    unsigned char& c = bs.cell[i*bs.cols + j];
+    int type = BRICK_TYPE(c);
+    c = (type == BRICK_EXPLOSIVE) ? BRICK_BLAST_MARK : 0;
+    bs.aliveCount--;
+    w.score += (type == BRICK_EXPLOSIVE) ? 20 : 10;
+    if (!inChain) pushEvent(w, EV_BRICK_DESTROYED, i, j);
+    journalBrick(w, i*bs.cols + j, CHANGE_DESTROYED, 0);     // a blast mark is gone by the end of the tick
+
+    if (type == BRICK_POWERUP || worldRand(w) % 4 == 0)
+        spawnPowerUp(w, px, py, (PowerType)(worldRand(w) % 3), inChain);
+}
+
+// Chain reaction from a destroyed explosive at cell `start`, all within this
+// tick. Iterative: explosives caught in a blast are marked in place and queued
+// on the World's fixed ring, so there is no recursion and nothing is allocated.
+// Marks that don't fit in the ring stay in the grid and are picked up by a sweep
+// of the cell range they fell in once the ring drains. However long the chain,
+// it reports one EV_BRICK_EXPLODED and at most one EV_POWERUP_SPAWNED, so it
+// can't crowd the rest of the tick's events (a win, say) out of the list.
+void resolveBlast(World& w, int start)
+{
+    BrickStore& bs = w.bricks;
+    const int mask = MAX_BLAST_QUEUE - 1;
+    int total = bs.rows * bs.cols;
+    unsigned int head = 0, tail = 0;
+    int sweepLo = total, sweepHi = -1;
+    auto enqueue = [&](int k)
+    {
+        if (tail - head < (unsigned int)MAX_BLAST_QUEUE)
+            w.blastQueue[tail++ & mask] = k;
+        else
+        {
+            if (k < sweepLo) sweepLo = k;
+            if (k > sweepHi) sweepHi = k;
+        }
+    };
+
+    int ev = w.eventCount;
+    pushEvent(w, EV_BRICK_EXPLODED, start / bs.cols, start % bs.cols);
+    unsigned int seq = w.journal.head;
+    int powerUps = w.powerUps.count;
+    enqueue(start);
+    for (;;)
+    {
+        while (head != tail)
+        {
+            int k = w.blastQueue[head++ & mask];
+            bs.cell[k] = 0;
+            int i = k / bs.cols, j = k % bs.cols;
+            for (int ni = i - 1; ni <= i + 1; ++ni)
+                for (int nj = j - 1; nj <= j + 1; ++nj)
+                {
+                    if (ni < 0 || nj < 0 || ni >= bs.rows || nj >= bs.cols) continue;
+                    int n = ni*bs.cols + nj;
+                    if (!BRICK_BREAKABLE(bs.cell[n])) continue;
+                    real cx = brickX(bs, nj) + bs.w * 0.5f, cy = brickY(bs, ni) - bs.h * 0.5f;
+                    destroyBrick(w, ni, nj, cx, cy, true);
+                    if (bs.cell[n] == BRICK_BLAST_MARK) enqueue(n);
+                }
+        }
+        if (sweepHi < 0) break;
+        int lo = sweepLo, hi = sweepHi;
+        sweepLo = total;
+        sweepHi = -1;
+        for (int k = lo; k <= hi; ++k)
+            if (bs.cell[k] == BRICK_BLAST_MARK) enqueue(k);
+    }
+    if (ev < w.eventCount)
+    {
+        w.events[ev].count = (int)(w.journal.head - seq);
+        w.events[ev].seq = seq;
+    }
+    if (w.powerUps.count > powerUps)
+    {
+        ev = w.eventCount;
+        pushEvent(w, EV_POWERUP_SPAWNED, w.powerUps.type[w.powerUps.count - 1], 0);
+        if (ev < w.eventCount) w.events[ev].count = w.powerUps.count - powerUps;
+    }
+}
+
+// Ball hit on a brick: steel just flashes, multi-hit bricks lose a point, the
+// last point destroys it
+void hitBrick(World& w, int i, int j, real px, real py)
+{
+    BrickStore& bs = w.bricks;
+    unsigned char& c = bs.cell[i*bs.cols + j];
+    int type = BRICK_TYPE(c), hp = BRICK_HP(c);
+    if (type == BRICK_STEEL)
+    {
+        pushEvent(w, EV_BRICK_DAMAGED, i, j);
+        return;
+    }
+    if (hp > 1)
+    {
+        c = BRICK_CELL(type, hp - 1);
+        w.score += 5;
+        pushEvent(w, EV_BRICK_DAMAGED, i, j);
+        journalBrick(w, i*bs.cols + j, CHANGE_DAMAGED, c);
+        return;
+    }
+    destroyBrick(w, i, j, px, py);
+    if (type == BRICK_EXPLOSIVE) resolveBlast(w, i*bs.cols + j);
+}
+
+// Ball against the brick colliders. Only the cells under the ball's bounding
+// box are visited, in the same row-major order as a full scan.
+template <class G>
+void brickCollisionImpl(World& w, const G& g)
+{
+    Ball& b = w.ball;
+    BrickStore& bs = w.bricks;
+    real bw = g.brickW(), bh = g.brickH();
+
+    // cell range, padded a little so rounding can't drop a touching cell;
+    // the exact overlap test below rejects the extras
+    const real pad = 1e-3f;
+    real startX = g.startX(), startY = g.startY();
+    real cx0 = (b.x - ballRadius - startX) * g.invPitchX();
+    real cx1 = (b.x + ballRadius - startX) * g.invPitchX();
+    real cy0 = (startY - (b.y + ballRadius)) * g.invPitchY();
+    real cy1 = (startY - (b.y - ballRadius)) * g.invPitchY();
+    int j0 = fastFloor(cx0 - pad), j1 = fastFloor(cx1 + pad);
+    int i0 = fastFloor(cy0 - pad), i1 = fastFloor(cy1 + pad);
+    if (j0 < 0) j0 = 0;
+    if (i0 < 0) i0 = 0;
+    if (j1 > g.cols() - 1) j1 = g.cols() - 1;
+    if (i1 > g.rows() - 1) i1 = g.rows() - 1;
+
+    auto visit = [&](int i, int j)
+    {
+        unsigned char& c = bs.cell[i*g.cols() + j];
+        if (!BRICK_HP(c)) return;
+        real x = g.colX(j), y = g.rowY(i);
+
+        if (b.x + ballRadius > x && b.x - ballRadius < x + bw &&
+                b.y + ballRadius > y - bh && b.y - ballRadius < y)
+        {
+            // Collision response
+            real overlapLeft   = (b.x + ballRadius) - x;
+            real overlapRight  = (x + bw) - (b.x - ballRadius);
+            real overlapTop    = (y) - (b.y - ballRadius);
+            real overlapBottom = (b.y + ballRadius) - (y - bh);
+
+            bool invertX = (overlapLeft < overlapTop && overlapLeft < overlapBottom) ||
+                           (overlapRight < overlapTop && overlapRight < overlapBottom);
+            if (invertX) b.dx = -b.dx;
+            else         b.dy = -b.dy;
+
+            hitBrick(w, i, j, b.x, b.y);
+        }
+    };
+    if (i0 <= i1 && j0 <= j1) g.forEachCandidate(i0, i1, j0, j1, visit);
+}
+
+void sysBrickCollision(World& w)
+{
+    withBoard(w.bricks, [&](const auto& g) { brickCollisionImpl(w, g); });
+}
+
+// Start an effect, or push back the deadline of the one already running
+void refreshEffect(World& w, EffectKind kind, int deadlineMs)
+{
+    EffectStore& es = w.effects;
+    for (int i = 0; i < es.count; ++i)
+        if (es.heap[i].kind == kind)
+        {
+            es.heap[i].deadlineMs = deadlineMs;
+            effectSiftUp(es, i);
+            effectSiftDown(es, i);
+            return;
+        }
+    pushEffect(w, kind, deadlineMs);
+}
+
+// Powerups fall & collect
+void sysPickup(World& w, int now)
+{
+    PowerUpStore& ps = w.powerUps;
+    Paddle& p = w.paddle;
+
+    // straight SoA add, kept separate so it vectorises (paddd in fixed point)
+    for (int k = 0; k < ps.count; ++k)
+        ps.y[k] += ps.vy[k];
+
+    int i = 0;
+    while (i < ps.count)
+    {
+        // Paddle collect
+        if (ps.y[i] <= -0.95f + paddleHeight &&
+                ps.x[i] >= p.x - p.width/2 - 0.03f &&
+                ps.x[i] <= p.x + p.width/2 + 0.03f)
+        {
+            PowerType t = ps.type[i];
+            if (t == POWER_EXTRA_LIFE) w.lives++;
+            else if (t == POWER_FASTER_BALL)
+            {
+                // each pickup stacks with its own expiry
+                if (pushEffect(w, EFFECT_FAST_BALL, now + FAST_BALL_DURATION_MS)) applyFastBall(w);
+            }
+            else if (t == POWER_WIDER_PADDLE)
+            {
+                if (!countEffects(w, EFFECT_WIDE_PADDLE))
+                {
+                    p.width *= 1.6f;
+                    if (p.width > PADDLE_MAX_WIDTH) p.width = PADDLE_MAX_WIDTH;
+                }
+                refreshEffect(w, EFFECT_WIDE_PADDLE, now + PADDLE_WIDEN_DURATION_MS);
+            }
+            w.score += 50;
+            pushEvent(w, EV_POWERUP_COLLECTED, t, 0);
+            removePowerUp(ps, i);
+            continue;
+        }
+
+        // Missed
+        if (ps.y[i] < -1.2f)
+        {
+            removePowerUp(ps, i);
+            continue;
+        }
+        ++i;
+    }
+}
+
+// Expire timed effects and undo them; runs every tick, even before launch
+void sysEffects(World& w, int now)
+{
+    EffectStore& es = w.effects;
+    while (es.count > 0 && es.heap[0].deadlineMs <= now)
+    {
+        EffectKind kind = es.heap[0].kind;
+        removeEffectAt(es, 0);
+        switch (kind)
+        {
+        case EFFECT_SPEED_RAMP:
+            w.ball.dx *= SPEED_INCREASE_FACTOR;
+            w.ball.dy *= SPEED_INCREASE_FACTOR;
+            pushEffect(w, EFFECT_SPEED_RAMP, now + SPEED_INCREASE_INTERVAL_MS);
+            break;
+        case EFFECT_WIDE_PADDLE:
+            w.paddle.width /= 1.6f;
+            if (w.paddle.width < PADDLE_MIN_WIDTH) w.paddle.width = PADDLE_MIN_WIDTH;
+            break;
+        case EFFECT_FAST_BALL:
+            applyFastBall(w);
+            break;
+        }
+    }
+}
+
+// One fixed SIM_TICK_MS simulation tick at wall time `now`. GL-free.
+void stepWorld(World& w, int now)
+{
+    w.eventCount = 0;
+    w.journal.tickStart = w.journal.head;
+    int gameMs = now - w.totalPausedMs;
+    sysEffects(w, gameMs);
+    sysTrail(w);
+
+    if (w.lives > 0 && w.ball.moving)
+    {
+        sysMovement(w);
+        sysBrickCollision(w);
+
+        // Check win
+        if (w.bricks.aliveCount == 0)
+        {
+            w.ball.moving = false;
+            pushEvent(w, EV_WIN, 0, 0);
+        }
+
+        // Ball fall (lose life)
+        if (w.ball.y < -1.1f)
+        {
+            w.lives--;
+            pushEvent(w, EV_LIFE_LOST, 0, 0);
+            if (w.lives > 0) resetBall(w);
+            else
+            {
+                w.ball.moving = false;
+                pushEvent(w, EV_GAMEOVER, 0, 0);
+            }
+        }
+
+        sysPickup(w, gameMs);
+    }
+}
+
+// -------------------------- Fast-forward --------------------------
+// Event-driven stepping for replays and bot rollouts. Between contacts a tick
+// only moves the ball, the falling power-ups and the trail, so quietTicks works
+// out how many ticks ahead the next wall, paddle band, brick, pickup line, lost
+// ball or timer can be, and skipQuietTicks applies all of them at once. The
+// tick that does hit something is always run through stepWorld, so the state
+// at every event matches calling stepWorld once per tick.
+const float QUIET_MARGIN = 1e-3f;   // distance slack covering float round-off
+#define QUIET_SCAN_CELLS 256        // brick cells examined per estimate, at most
+
+// Whole ticks a gap survives while closing at `speed` per tick, up to limit
+int ticksToClose(float gap, float speed, int limit)
+{
+    if (gap <= QUIET_MARGIN) return 0;
+    if (speed <= 0.0f) return limit;
+    float t = (gap - QUIET_MARGIN) / speed;
+    return t >= (float)limit ? limit : (int)t;
+}
+
+// Lower bound on ticks before the ball's box can overlap [l,r]x[bottom,top]
+int ticksToRect(float x, float y, float vx, float vy,
+                float l, float r, float bottom, float top, int limit)
+{
+    float left = l - (x + ballRadius), right = (x - ballRadius) - r;
+    float below = bottom - (y + ballRadius), above = (y - ballRadius) - top;
+    int tx = left > right ? ticksToClose(left, vx, limit) : ticksToClose(right, -vx, limit);
+    int ty = below > above ? ticksToClose(below, vy, limit) : ticksToClose(above, -vy, limit);
+    return tx > ty ? tx : ty;
+}
+
+// Ticks with now + i*SIM_TICK_MS still before the deadline
+int ticksBefore(int now, int deadlineMs)
+{
+    if (deadlineMs <= now) return 0;
+    return (deadlineMs - now + SIM_TICK_MS - 1) / SIM_TICK_MS;
+}
+
+// Bricks only ever go away during play, so the band of rows that can still
+// hold one only narrows; move its edges in past the rows that have emptied
+void trimLiveRows(BrickStore& bs)
+{
+    auto empty = [&](int i)
+    {
+        const unsigned char* row = bs.cell + i*bs.cols;
+        for (int j = 0; j < bs.cols; ++j)
+            if (BRICK_HP(row[j])) return false;
+        return true;
+    };
+    while (bs.liveTop <= bs.liveBottom && empty(bs.liveBottom)) bs.liveBottom--;
+    while (bs.liveTop <= bs.liveBottom && empty(bs.liveTop)) bs.liveTop++;
+}
+
+// Ticks before the ball can reach a brick. Bricks are only scanned near the
+// ball, inside the band of live rows: the window covers what it can travel in
+// the ticks being asked about, and the span asked about shrinks until the
+// window is small.
+int quietBrickTicks(const World& w, float x, float y, float vx, float vy, int limit)
+{
+    const BrickStore& bs = w.bricks;
+    if (bs.liveTop > bs.liveBottom) return limit;
+    float boardR = bs.startX + (bs.cols - 1) * bs.pitchX + bs.w;
+    float boardT = brickY(bs, bs.liveTop), boardB = brickY(bs, bs.liveBottom) - bs.h;
+    if (ticksToRect(x, y, vx, vy, bs.startX, boardR, boardB, boardT, limit) >= limit)
+        return limit;
+
+    int cap = limit, i0, i1, j0, j1;
+    for (;;)
+    {
+        float reachX = fabsf(vx) * cap + ballRadius + QUIET_MARGIN;
+        float reachY = fabsf(vy) * cap + ballRadius + QUIET_MARGIN;
+        j0 = (int)floorf((x - reachX - bs.w - bs.startX) * bs.invPitchX);
+        j1 = (int)floorf((x + reachX - bs.startX) * bs.invPitchX) + 1;
+        i0 = (int)floorf((bs.startY - bs.h - y - reachY) * bs.invPitchY);
+        i1 = (int)floorf((bs.startY - y + reachY) * bs.invPitchY) + 1;
+        if (j0 < 0) j0 = 0;
+        if (i0 < bs.liveTop) i0 = bs.liveTop;
+        if (j1 > bs.cols - 1) j1 = bs.cols - 1;
+        if (i1 > bs.liveBottom) i1 = bs.liveBottom;
+        if (cap == 1 || (long long)(i1 - i0 + 1) * (j1 - j0 + 1) <= QUIET_SCAN_CELLS) break;
+        cap /= 2;
+    }
+
+    // a brick can't be reached before both its row and its column can
+    int n = cap;
+    for (int i = i0; i <= i1; ++i)
+    {
+        float by = brickY(bs, i);
+        float below = (by - bs.h) - (y + ballRadius), above = (y - ballRadius) - by;
+        int ty = below > above ? ticksToClose(below, vy, n) : ticksToClose(above, -vy, n);
+        if (ty >= n) continue;
+        const unsigned char* row = bs.cell + i*bs.cols;
+        for (int j = j0; j <= j1; ++j)
+        {
+            if (!BRICK_HP(row[j])) continue;
+            float bx = brickX(bs, j);
+            float left = bx - (x + ballRadius), right = (x - ballRadius) - (bx + bs.w);
+            int tx = left > right ? ticksToClose(left, vx, n) : ticksToClose(right, -vx, n);
+            int t = tx > ty ? tx : ty;
+            if (t < n) n = t;
+            if (n <= ty) break;
+        }
+        if (n == 0) return 0;
+    }
+    return n;
+}
+
+// How many ticks from `now` are guaranteed to do nothing but move things
+int quietTicks(const World& w, int now, int limit)
+{
+    int n = limit, t;
+    if (w.effects.count > 0)
+    {
+        t = ticksBefore(now - w.totalPausedMs, w.effects.heap[0].deadlineMs);
+        if (t < n) n = t;
+    }
+    if (!(w.lives > 0 && w.ball.moving) || n == 0) return n;
+    if (w.bricks.aliveCount == 0) return 0;
+
+    const Ball& b = w.ball;
+    float x = toF(b.x), y = toF(b.y);
+    float vx = toF(b.dx * b.speedMul), vy = toF(b.dy * b.speedMul);
+    auto bound = [&](int ticks) { if (ticks < n) n = ticks; };
+
+    // walls
+    bound(ticksToClose((1.0f - ballRadius) - x, vx, n));
+    bound(ticksToClose(x - (-1.0f + ballRadius), -vx, n));
+    bound(ticksToClose((w.bricks.ceilY - ballRadius) - y, vy, n));
+
+    // paddle band, then the lost-ball line under it
+    float bandTop = -0.95f + paddleHeight, bandBottom = -0.95f - 0.02f;
+    float low = y - ballRadius;
+    if (low > bandTop + QUIET_MARGIN) bound(ticksToClose(low - bandTop, -vy, n));
+    else if (low >= bandBottom - QUIET_MARGIN || vy > 0.0f) return 0;
+    bound(ticksToClose(y - (-1.1f), -vy, n));
+
+    // power-ups reaching the pickup line, or the bottom after missing the paddle
+    const PowerUpStore& ps = w.powerUps;
+    const Paddle& p = w.paddle;
+    float pl = toF(p.x - p.width/2) - 0.03f - QUIET_MARGIN;
+    float pr = toF(p.x + p.width/2) + 0.03f + QUIET_MARGIN;
+    for (int i = 0; i < ps.count && n > 0; ++i)
+    {
+        float py = toF(ps.y[i]), px = toF(ps.x[i]);
+        if (py > bandTop + QUIET_MARGIN) bound(ticksToClose(py - bandTop, -toF(ps.vy[i]), n));
+        else if (px >= pl && px <= pr) return 0;
+        else bound(ticksToClose(py - (-1.2f), -toF(ps.vy[i]), n));
+    }
+
+    if (n > 0) bound(quietBrickTicks(w, x, y, vx, vy, n));
+    return n;
+}
+
+#if !defined(DXB_FIXED_PHYSICS) && FLT_EVAL_METHOD == 0
+// x after k rounds of x += v in float arithmetic. While x and every exact sum
+// x + v stay inside one binade, each add rounds v to the same multiple of that
+// binade's spacing, so a run of them is x + n*r, exact in double. A stride
+// costs about as much as twenty adds, so it is only taken in binades that hold
+// at least FLOAT_RUN_MIN_ADDS of them; nearer zero, across binade edges and on
+// rounding ties the adds are made one by one. Signs are mirrored so x is never
+// negative, which round-to-nearest doesn't notice.
+#define FLOAT_RUN_MIN_ADDS 64
+float floatAddRun(float x, float v, int k)
+{
+    float sign = 1.0f, wide = 2 * FLOAT_RUN_MIN_ADDS * fabsf(v);
+    while (k > 0)
+    {
+        if (fabsf(x) < wide)
+        {
+            // too near zero for a stride to pay
+            do
+            {
+                x = x + v;
+                k--;
+            }
+            while (k > 0 && fabsf(x) < wide);
+            continue;
+        }
+        if (x < 0.0f)
+        {
+            x = -x;
+            v = -v;
+            sign = -sign;
+        }
+        long n = 0;
+        double r = 0.0;
+        unsigned int bits;
+        memcpy(&bits, &x, sizeof(bits));
+        if (bits < 0x7f000000u)                         // below the top binade
+        {
+            float lof, invf;
+            bits &= 0x7f800000u;
+            unsigned int invBits = 0x7f000000u - bits;  // 1/lo, also a power of two
+            memcpy(&lof, &bits, sizeof(lof));
+            memcpy(&invf, &invBits, sizeof(invf));
+            double lo = lof, hi = 2.0 * lo;             // x in [lo, hi)
+            double u = lo * (1.0 / 8388608.0);          // float spacing there, 2^-23 lo
+            double q = (double)v * invf * 8388608.0;    // v / u, exact
+            double rq = (q + 6755399441055744.0) - 6755399441055744.0;   // nearest integer
+            double s0 = (double)x + v;                  // exact sum of the first add
+            if (fabs(q - rq) != 0.5 && s0 >= lo && s0 < hi)
+            {
+                // sums s0 + m*r, m < n, all in [lo, hi); one short of the
+                // bound so rounding in the division can't overshoot
+                r = rq * u;
+                if (r == 0.0) n = k;
+                else if (r > 0.0) n = (long)((hi - s0) / r) - 1;
+                else n = (long)((s0 - lo) / -r);
+                if (n > k) n = k;
+            }
+        }
+        if (n > 0)
+        {
+            x = (float)(x + n * r);
+            k -= n;
+        }
+        else
+        {
+            x = x + v;
+            k--;
+        }
+    }
+    return sign * x;
+}
+#endif
+
+// Apply k quiet ticks: the same state k stepWorld calls would leave
+void skipQuietTicks(World& w, int k)
+{
+    Ball& b = w.ball;
+    PowerUpStore& ps = w.powerUps;
+    w.eventCount = 0;
+
+    // the trail holds the positions from before each of the last moves
+    for (int m = TRAIL_LEN - 1; m >= k; --m)
+    {
+        b.trailX[m] = b.trailX[m - k];
+        b.trailY[m] = b.trailY[m - k];
+    }
+    if (!(w.lives > 0 && b.moving))
+    {
+        for (int m = 0; m < k && m < TRAIL_LEN; ++m)
+        {
+            b.trailX[m] = b.x;
+            b.trailY[m] = b.y;
+        }
+        return;
+    }
+
+#ifdef DXB_FIXED_PHYSICS
+    // integer adds: n steps of v are exactly n*v
+    real vx = b.dx * b.speedMul, vy = b.dy * b.speedMul;
+    for (int m = 0; m < k && m < TRAIL_LEN; ++m)
+    {
+        b.trailX[m] = real::raw(b.x.v + (k - 1 - m) * vx.v);
+        b.trailY[m] = real::raw(b.y.v + (k - 1 - m) * vy.v);
+    }
+    b.x = real::raw(b.x.v + k * vx.v);
+    b.y = real::raw(b.y.v + k * vy.v);
+    for (int i = 0; i < ps.count; ++i)
+        ps.y[i] = real::raw(ps.y[i].v + k * ps.vy[i].v);
+#elif FLT_EVAL_METHOD == 0
+    // float sums depend on the order, so the span up to the trail is run in
+    // binade-sized strides by floatAddRun and the last adds are made one by one
+    real vx = b.dx * b.speedMul, vy = b.dy * b.speedMul;
+    int lead = k > TRAIL_LEN ? k - TRAIL_LEN : 0;
+    b.x = floatAddRun(b.x, vx, lead);
+    b.y = floatAddRun(b.y, vy, lead);
+    for (int n = k - lead - 1; n >= 0; --n)
+    {
+        b.trailX[n] = b.x;
+        b.trailY[n] = b.y;
+        b.x += vx;
+        b.y += vy;
+    }
+    for (int i = 0; i < ps.count; ++i)
+        ps.y[i] = floatAddRun(ps.y[i], ps.vy[i], k);
+#else
+    // wider intermediates (x87) round differently from one float add at a
+    // time, so repeat the adds the ticks would make
+    for (int n = k - 1; n >= 0; --n)
+    {
+        if (n < TRAIL_LEN)
+        {
+            b.trailX[n] = b.x;
+            b.trailY[n] = b.y;
+        }
+        b.x += b.dx * b.speedMul;
+        b.y += b.dy * b.speedMul;
+    }
+    for (int n = 0; n < k; ++n)
+        for (int i = 0; i < ps.count; ++i)
+            ps.y[i] += ps.vy[i];
+#endif
+}
+
+// Advance up to `ticks` ticks, the first at `now`. Stops after any tick that
+// produced events so the caller can handle them and give input; returns the
+// number of ticks taken.
+int fastForward(World& w, int now, int ticks)
+{
+    int done = 0;
+    while (done < ticks)
+    {
+        int t = now + done * SIM_TICK_MS;
+        trimLiveRows(w.bricks);
+        int quiet = quietTicks(w, t, ticks - done);
+        if (quiet > 0)
+        {
+            skipQuietTicks(w, quiet);
+            done += quiet;
+            if (done == ticks) break;
+            // the span ends where something may be hit, most often on the
+            // very next tick, so that one is stepped without asking again
+            t = now + done * SIM_TICK_MS;
+        }
+        stepWorld(w, t);
+        done++;
+        if (w.eventCount > 0) break;
+    }
+    return done;
+}
+
+// Fades for the bricks a chain destroyed, read back from the journal. A chain
+// longer than the ring has lost its first entries; those bricks just vanish.
+void startBlastFades(const World& w, const WorldEvent& e)
+{
+    const BrickJournal& jr = w.journal;
+    unsigned int first = e.seq, end = e.seq + e.count;
+    if (jr.head - first > BRICK_JOURNAL_SIZE) first = jr.head - BRICK_JOURNAL_SIZE;
+    for (unsigned int s = first; (int)(end - s) > 0; ++s)
+    {
+        int k = jr.ring[s & (BRICK_JOURNAL_SIZE - 1)].cell;
+        startAnim(ANIM_BRICK_FADE, k / w.bricks.cols, k % w.bricks.cols, 1.25f);
+    }
+}
+
+// Turn world events into animations and state changes
+void handleWorldEvents(const World& w)
+{
+    int collisions = 0;
+    for (int i = 0; i < w.eventCount; ++i)
+    {
+        const WorldEvent& e = w.events[i];
+        switch (e.kind)
+        {
+        case EV_BRICK_DESTROYED:
+            collisions++;
+            startAnim(ANIM_BRICK_FADE, e.a, e.b, 1.25f);
+            playSound(SND_BRICK, 0.8f, (e.b - (w.bricks.cols - 1) * 0.5f) / w.bricks.cols);
+            break;
+        case EV_BRICK_DAMAGED:
+            collisions++;
+            startAnim(ANIM_FLASH, e.a, e.b, 6.0f);
+            playSound(SND_BRICK_HIT, 0.6f, (e.b - (w.bricks.cols - 1) * 0.5f) / w.bricks.cols);
+            break;
+        case EV_BRICK_EXPLODED:
+            startAnim(ANIM_SHAKE, -1, -1, 4.0f);
+            startBlastFades(w, e);
+            if (e.count > 0) playSound(SND_BRICK, 1.0f, (e.b - (w.bricks.cols - 1) * 0.5f) / w.bricks.cols);
+            break;
+        case EV_PADDLE_HIT:
+            collisions++;
+            playSound(SND_PADDLE, 0.8f, toF(w.paddle.x));
+            break;
+        case EV_POWERUP_SPAWNED:
+            countMetric(M_POWERUPS_SPAWNED, e.count);
+            break;
+        case EV_POWERUP_COLLECTED:
+            countMetric(M_POWERUPS_COLLECTED);
+            playSound(SND_POWERUP, 0.8f, toF(w.paddle.x));
+            break;
+        case EV_LIFE_LOST:
+            countMetric(M_LIVES_LOST);
+            session.livesUsed++;
+            playSound(SND_LOSE, 0.5f, 0.0f);
+            break;
+        case EV_WIN:
+            if (hasNextLevel())
+            {
+                session.bricksCleared += session.boardBricks;
+                session.boardBricks = 0;
+            }
+            else endSession(w);
+            state = STATE_WIN;
+            playSound(SND_WIN, 1.0f, 0.0f);
+            break;
+        case EV_GAMEOVER:
+            endSession(w);
+            state = STATE_GAMEOVER;
+            playSound(SND_LOSE, 1.0f, 0.0f);
+            break;
+        }
+    }
+    histRecord(H_COLLISIONS_PER_TICK, collisions);
+}
+
+// Away from play nothing moves but the stars and the fireworks, so the loop
+// sleeps until the next of those steps and redraws once. Input redraws on its
+// own and restarts ticking right away. GLUT timers can't be cancelled, so each
+// restart bumps a generation and timers from older ones just return.
+int tickLoopGen = 0;
+bool tickLoopIdle = false;
+
+int idleRedrawDelayMs(int now)
+{
+    int delay = STAR_PERIOD_MS - now % STAR_PERIOD_MS;
+    if (state == STATE_WIN)
+    {
+        int fw = FIREWORK_PERIOD_MS - now % FIREWORK_PERIOD_MS;
+        if (fw < delay) delay = fw;
+    }
+    return delay;
+}
+
+// State changes come from event handling and from input; both check in here
+GameState countedState = STATE_MENU;
+
+void countStateChange()
+{
+    if (state == countedState) return;
+    countedState = state;
+    countMetric((CounterId)(M_ENTER_STATE + state));
+}
+
+void movePaddleTo(World& w, real nx)
+{
+    if (nx < -1.0f + w.paddle.width/2) nx = -1.0f + w.paddle.width/2;
+    if (nx >  1.0f - w.paddle.width/2) nx =  1.0f - w.paddle.width/2;
+    w.paddle.x = nx;
+}
+
+// A paddle move from the keyboard; the simulation owns the paddle again
+void keyPaddle(World& w, float dx)
+{
+    movePaddleTo(w, w.paddle.x + dx);
+    releasePointer();
+    handUs = nowUs();
+}
+
+// Only records the pointer; the next tick moves the paddle
+void mouseMove(int x, int y)
+{
+    if (state != STATE_PLAYING) return;
+    pointerX = x;
+    handUs = pointerUs = nowUs();
+    pointerPending = pointerActive = true;
+}
+
+void applyPointer(World& w)
+{
+    if (!pointerPending) return;
+    movePaddleTo(w, pointerToWorld(pointerX));
+    simPointerUs = pointerUs;
+    pointerPending = false;
+}
+
+void update(int gen)
+{
+    if (gen != tickLoopGen) return;
+    AllocScope scope(PHASE_TICK);
+    int now = glutGet(GLUT_ELAPSED_TIME);
+
+    // animations run on their own clock, independent of ballMoving
+    updateAnims(now);
+
+    if (state == STATE_MENU && attractMode)
+    {
+        tickLoopIdle = false;
+        pace.tickStartUs = nowUs();
+        int first, n = ticksDue(now, &first);
+        for (int k = 0; k < n; ++k) stepAttract(first + k * SIM_TICK_MS);
+        glutPostRedisplay();
+        glutTimerFunc(nextTickDelayMs(nowUs()), update, gen);
+        return;
+    }
+    if (state != STATE_PLAYING)
+    {
+        tickLoopIdle = true;
+        glutPostRedisplay();
+        glutTimerFunc(idleRedrawDelayMs(now), update, gen);
+        return;
+    }
+
+    tickLoopIdle = false;
+    pace.tickStartUs = nowUs();
+    int first, n = ticksDue(now, &first);
+    for (int k = 0; k < n && state == STATE_PLAYING; ++k)
+    {
+        int t = first + k * SIM_TICK_MS;
+        applyPointer(g_world);
+        if (assistMode) assistTick(g_world, t);
+        stepWorld(g_world, t);
+        session.playMs += SIM_TICK_MS;
+        countMetric(M_TICKS);
+        handleWorldEvents(g_world);
+        countStateChange();
+    }
+
+    glutPostRedisplay();
+    glutTimerFunc(nextTickDelayMs(nowUs()), update, gen);
+}
+
+// Clicks and keys can change what is on screen or start play
+void afterInput()
+{
+    countStateChange();
+    glutPostRedisplay();
+    if (tickLoopIdle && (state == STATE_PLAYING || (state == STATE_MENU && attractMode)))
+    {
+        tickLoopIdle = false;
+        glutTimerFunc(0, update, ++tickLoopGen);
+    }
+}
+
+void resumeGame()
+{
+    state = STATE_PLAYING;
+    if (g_world.pauseStartTimeMs)
+    {
+        g_world.totalPausedMs += glutGet(GLUT_ELAPSED_TIME) - g_world.pauseStartTimeMs;
+        g_world.pauseStartTimeMs = 0;
+    }
+}
+
+// Button and shortcut handling shared by mouse and keyboard
+void runUiAction(UiAction a)
+{
+    switch (a)
+    {
+    case UI_START_GAME:
+        resetGame();
+        state = STATE_PLAYING;
+        break;
+    case UI_SHOW_INSTRUCTIONS:
+        state = STATE_INSTRUCTIONS;
+        break;
+    case UI_SHOW_MENU:
+        state = STATE_MENU;
+        break;
+    case UI_RESUME:
+        resumeGame();
+        break;
+    case UI_CONTINUE:
+        if (advanceCampaign(g_world, glutGet(GLUT_ELAPSED_TIME)))
+        {
+            session.boardBricks = g_world.bricks.aliveCount;
+            reserveFrameBuffers(g_world.bricks);
+            reserveAutopilot(g_world);
+            releasePointer();
+            clearAnims();
+            state = STATE_PLAYING;
+            break;
+        }
+        // last level: play again
+        // fall through
+    case UI_RESTART:
+        resetGame();
+        state = STATE_PLAYING;
+        break;
+    case UI_QUIT:
+        exit(0);
+    default:
+        break;
+    }
+}
+
+void mouseClick(int button, int mstate, int x, int y)
+{
+    if (button == GLUT_LEFT_BUTTON && mstate == GLUT_DOWN)
+    {
+        if (state == STATE_PLAYING)
+        {
+            if (!g_world.ball.moving && g_world.lives > 0)
+                g_world.ball.moving = true;
+            return;
+        }
+
+        float nx = (float)x / (float)g_winW * 2.0f - 1.0f;
+        float ny = 1.0f - (float)y / (float)g_winH * 2.0f; // convert to NDC
+        runUiAction(uiHitTest(state, nx, ny));
+    }
+}
+
+// keyboard ascii
+void keyboardASCII(unsigned char key, int x, int y)
+{
+    World& w = g_world;
+    if (key == 27) exit(0);
+    if (state == STATE_MENU)
+    {
+        if (key == ' ' || key == '\r') runUiAction(UI_START_GAME);
+    }
+    else if (state == STATE_PLAYING)
+    {
+        if (key == ' ')
+        {
+            if (!w.ball.moving && w.lives > 0) w.ball.moving = true;
+        }
+        else if (key == 'p' || key == 'P')
+        {
+            state = STATE_PAUSED;
+            w.pauseStartTimeMs = glutGet(GLUT_ELAPSED_TIME);
+        }
+        else if (key == 'r' || key == 'R')
+        {
+            resetGame();
+        }
+        else if (key == 'a' || key == 'A')
+        {
+            keyPaddle(w, -0.06f);
+        }
+        else if (key == 'd' || key == 'D')
+        {
+            keyPaddle(w, 0.06f);
+        }
+    }
+    else if (state == STATE_PAUSED)
+    {
+        if (key == 'p' || key == 'P') runUiAction(UI_RESUME);
+    }
+    else if (state == STATE_GAMEOVER || state == STATE_WIN)
+    {
+        if (key == ' ' && state == STATE_WIN) runUiAction(UI_CONTINUE);
+        else if (key == 'r' || key == 'R' || key == ' ') runUiAction(UI_RESTART);
+    }
+}
+
+void mouseClickInput(int button, int mstate, int x, int y)
+{
+    AllocScope scope(PHASE_INPUT);
+    mouseClick(button, mstate, x, y);
+    afterInput();
+}
+
+void keyboardInput(unsigned char key, int x, int y)
+{
+    AllocScope scope(PHASE_INPUT);
+    keyboardASCII(key, x, y);
+    afterInput();
+}
+
+// arrow keys
+void keyboardSpecial(int key, int x, int y)
+{
+    if (state != STATE_PLAYING) return;
+    const float step = 0.06f;
+    if (key == GLUT_KEY_LEFT)
+    {
+        keyPaddle(g_world, -step);
+    }
+    else if (key == GLUT_KEY_RIGHT)
+    {
+        keyPaddle(g_world, step);
+    }
+}
+
+void keyboardSpecialInput(int key, int x, int y)
+{
+    AllocScope scope(PHASE_INPUT);
+    keyboardSpecial(key, x, y);
+    afterInput();
+}
+
+// Motion only leaves the pointer for the next tick and the late-latched paddle,
+// so it doesn't wake anything
+void mouseMoveInput(int x, int y)
+{
+    AllocScope scope(PHASE_INPUT);
+    mouseMove(x, y);
+}
+
+void reshape(int w, int h)
+{
+    g_winW = w;
+    g_winH = h;
+    glViewport(0,0,w,h);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluOrtho2D(-1,1,-1,1);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    // recompute brick layout in case spacing needs to adapt in future
+    if (g_world.bricks.cell) computeBrickLayout(g_world.bricks);
+    uiLayout();
+}
+
+// -------------------------- Worker pool --------------------------
+// A few threads kept around for data-parallel jobs: parallelFor(n, fn, ctx)
+// runs fn(ctx, i) for every i in [0, n) on the pool and the calling thread.
+// Items are claimed one at a time from an atomic counter, so uneven items even
+// out. One job runs at a time; a caller that finds the pool busy just runs its
+// items itself.
+struct WorkerPool
+{
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    std::mutex callerLock;
+    std::condition_variable wake, done;
+    void (*fn)(void*, int);
+    void* ctx;
+    int count;
+    std::atomic<int> next;
+    int busy;               // workers still inside the current job
+    unsigned int job;       // bumped for every job
+    bool quit;
+    bool started;
+};
+WorkerPool g_pool;
+
+void runPoolItems(WorkerPool& p)
+{
+    for (int i = p.next.fetch_add(1); i < p.count; i = p.next.fetch_add(1))
+        p.fn(p.ctx, i);
+}
+
+void poolWorkerMain(WorkerPool* p)
+{
+    unsigned int seen = 0;
+    std::unique_lock<std::mutex> l(p->lock);
+    for (;;)
+    {
+        p->wake.wait(l, [&]() { return p->quit || p->job != seen; });
+        if (p->quit) return;
+        seen = p->job;
+        l.unlock();
+        runPoolItems(*p);
+        l.lock();
+        if (--p->busy == 0) p->done.notify_one();
+    }
+}
+
+void stopPool()
+{
+    {
+        std::lock_guard<std::mutex> l(g_pool.lock);
+        g_pool.quit = true;
+    }
+    g_pool.wake.notify_all();
+    for (size_t i = 0; i < g_pool.threads.size(); ++i) g_pool.threads[i].join();
+    g_pool.threads.clear();
+}
+
+// One thread per core besides the caller; none on a single core
+void startPool()
+{
+    g_pool.started = true;
+    int n = (int)std::thread::hardware_concurrency() - 1;
+    for (int i = 0; i < n; ++i) g_pool.threads.push_back(std::thread(poolWorkerMain, &g_pool));
+    if (n > 0) atexit(stopPool);
+}
+
+// Start the threads up front, so no tick has to create them
+void warmPool()
+{
+    std::lock_guard<std::mutex> caller(g_pool.callerLock);
+    if (!g_pool.started) startPool();
+}
+
+void parallelFor(int count, void (*fn)(void*, int), void* ctx)
+{
+    WorkerPool& p = g_pool;
+    std::unique_lock<std::mutex> caller(p.callerLock, std::try_to_lock);
+    if (caller.owns_lock() && !p.started) startPool();
+    if (!caller.owns_lock() || p.threads.empty() || count < 2)
+    {
+        for (int i = 0; i < count; ++i) fn(ctx, i);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> l(p.lock);
+        p.fn = fn;
+        p.ctx = ctx;
+        p.count = count;
+        p.next.store(0);
+        p.busy = (int)p.threads.size();
+        p.job++;
+    }
+    p.wake.notify_all();
+    runPoolItems(p);
+    std::unique_lock<std::mutex> l(p.lock);
+    p.done.wait(l, [&]() { return p.busy == 0; });
+}
+
+// -------------------------- Level generator --------------------------
+// Seeded levels for endless mode. A seed picks a pattern, a symmetry, a density
+// curve down the rows and a mix of brick types; every cell is then a pure
+// function of its tile's seed and its coordinates, so tiles are generated in
+// parallel and the result doesn't depend on the thread count. With symmetry
+// only the canonical part (left half, or top-left quarter) is generated and
+// then mirrored.
+//
+// Each tile is checked by playing it as a board of its own: the rollout bot
+// runs it fast-forwarded for a fixed budget. A tile cleared almost at once is
+// trivial; one where too few bricks fall is too hard. Either way the tile is
+// regenerated from its next seed. The whole level is then flood-filled from its
+// edges through everything but steel, and rejected if steel seals off any
+// breakable brick.
+enum GenPattern { PAT_SOLID, PAT_STRIPES, PAT_CHECKER, PAT_DIAMOND, PAT_WAVES, PAT_RINGS, PAT_COUNT };
+enum GenSymmetry { SYM_NONE, SYM_MIRROR, SYM_QUAD, SYM_COUNT };
+enum GenMix { MIX_NORMAL, MIX_TOUGH, MIX_STEEL, MIX_EXPLOSIVE, MIX_POWERUP, MIX_COUNT };
+
+#define GEN_TILE 16                 // tile edge in cells
+#define GEN_TILE_ATTEMPTS 8
+#define GEN_LEVEL_ATTEMPTS 4
+#define GEN_ROLLOUT_TICKS 12000     // budget per tile, about 3 minutes of play
+#define GEN_TRIVIAL_TICKS 900       // cleared faster than this is trivial
+#define GEN_MIN_CLEAR 0.5f          // fraction a tile must lose within budget
+
+struct GenParams
+{
+    unsigned int seed;
+    int rows, cols;
+    GenPattern pattern;
+    GenSymmetry symmetry;
+    int period;                     // pattern scale in cells
+    float densityTop, densityBottom, densityCurve;
+    float mix[MIX_COUNT];           // cumulative weights, last = 1
+};
+
+struct GenTile
+{
+    int row, col, rows, cols;       // in canonical coordinates
+    unsigned int seed;              // this tile's current attempt
+    int attempts;
+    float cleared;                  // fraction the rollout cleared
+    bool trivial, tooHard;          // verdict on the attempt kept
+};
+
+struct GenStats
+{
+    int tiles, tileRetries, trivialTiles, hardTiles, levelRetries, bricks;
+    bool steelStripped;
+};
+
+struct LevelGen
+{
+    GenParams p;
+    int canonRows, canonCols;
+    std::vector<unsigned char> canon;       // canonRows x canonCols
+    std::vector<GenTile> tiles;
+};
+
+unsigned int genHash(unsigned int a, unsigned int b, unsigned int c)
+{
+    unsigned int h = a * 0x9e3779b1u ^ (b + 0x7f4a7c15u) * 0x85ebca77u ^ (c + 0x165667b1u) * 0xc2b2ae3du;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+float genUnit(unsigned int h)
+{
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+// Level look from the seed; difficulty 0..1 raises density, tough bricks and steel
+GenParams genParams(unsigned int seed, int rows, int cols, float difficulty)
+{
+    GenParams p;
+    p.seed = seed;
+    p.rows = rows;
+    p.cols = cols;
+    p.pattern = (GenPattern)(genHash(seed, 1, 0) % PAT_COUNT);
+    p.symmetry = (GenSymmetry)(genHash(seed, 2, 0) % SYM_COUNT);
+    p.period = 2 + genHash(seed, 3, 0) % 4;
+    p.densityTop = 0.55f + 0.35f * difficulty + 0.10f * genUnit(genHash(seed, 4, 0));
+    p.densityBottom = 0.30f + 0.40f * difficulty * genUnit(genHash(seed, 5, 0));
+    p.densityCurve = 0.5f + 1.5f * genUnit(genHash(seed, 6, 0));
+    float w[MIX_COUNT];
+    w[MIX_NORMAL] = 1.0f;
+    w[MIX_TOUGH] = 0.10f + 0.50f * difficulty;
+    w[MIX_STEEL] = 0.02f + 0.08f * difficulty * genUnit(genHash(seed, 7, 0));
+    w[MIX_EXPLOSIVE] = 0.03f + 0.05f * genUnit(genHash(seed, 8, 0));
+    w[MIX_POWERUP] = 0.05f;
+    float sum = 0.0f;
+    for (int k = 0; k < MIX_COUNT; ++k) sum += w[k];
+    float acc = 0.0f;
+    for (int k = 0; k < MIX_COUNT; ++k)
+    {
+        acc += w[k] / sum;
+        p.mix[k] = acc;
+    }
+    p.mix[MIX_COUNT - 1] = 1.0f;
+    return p;
+}
+
+bool genPatternHas(const GenParams& p, int i, int j)
+{
+    float u = (j + 0.5f) / p.cols * 2.0f - 1.0f;
+    float v = (i + 0.5f) / p.rows * 2.0f - 1.0f;
+    switch (p.pattern)
+    {
+    case PAT_STRIPES: return (i / p.period) % 2 == 0 || i % p.period == 0;
+    case PAT_CHECKER: return (i / p.period + j / p.period) % 2 == 0;
+    case PAT_DIAMOND: return fabsf(u) + fabsf(v) < 1.1f;
+    case PAT_WAVES:   return fabsf(v - 0.6f * sinf(u * 3.14159f * p.period * 0.5f)) < 0.45f;
+    case PAT_RINGS:   return (int)(sqrtf(u*u + v*v) * p.period * 1.5f) % 2 == 0;
+    default:          return true;
+    }
+}
+
+unsigned char genCell(const GenParams& p, unsigned int tileSeed, int i, int j)
+{
+    if (!genPatternHas(p, i, j)) return 0;
+    float t = p.rows > 1 ? (float)i / (p.rows - 1) : 0.0f;
+    float density = p.densityTop + (p.densityBottom - p.densityTop) * powf(t, p.densityCurve);
+    if (genUnit(genHash(tileSeed, i, j)) >= density) return 0;
+    float r = genUnit(genHash(tileSeed ^ 0x5bd1e995u, i, j));
+    int k = 0;
+    while (k < MIX_COUNT - 1 && r >= p.mix[k]) k++;
+    switch (k)
+    {
+    case MIX_TOUGH:     return BRICK_CELL(BRICK_NORMAL, 2 + genHash(tileSeed, j, i) % 2);
+    case MIX_STEEL:     return BRICK_CELL(BRICK_STEEL, 1);
+    case MIX_EXPLOSIVE: return BRICK_CELL(BRICK_EXPLOSIVE, 1);
+    case MIX_POWERUP:   return BRICK_CELL(BRICK_POWERUP, 1);
+    default:            return BRICK_CELL(BRICK_NORMAL, 1);
+    }
+}
+
+void genFillTile(LevelGen& g, const GenTile& t)
+{
+    for (int i = t.row; i < t.row + t.rows; ++i)
+        for (int j = t.col; j < t.col + t.cols; ++j)
+            g.canon[(size_t)i * g.canonCols + j] = genCell(g.p, t.seed, i, j);
+}
+
+// Where a falling ball reaches the paddle line if nothing is in the way, and
+// in how many ticks. False while the ball is going up.
+bool predictLanding(const World& g, float* x, float* ticks)
+{
+    const Ball& b = g.ball;
+    float vx = toF(b.dx * b.speedMul), vy = toF(b.dy * b.speedMul);
+    if (vy >= 0.0f) return false;
+    float t = (toF(b.y) - ballRadius - (-0.95f + paddleHeight)) / -vy;
+    // fold the landing point back between the walls
+    float lo = -1.0f + ballRadius, span = 2.0f * (1.0f - ballRadius);
+    float u = fmodf(toF(b.x) + vx * t - lo, 2.0f * span);
+    if (u < 0.0f) u += 2.0f * span;
+    if (u > span) u = 2.0f * span - u;
+    *x = lo + u;
+    if (ticks) *ticks = t;
+    return true;
+}
+
+// Rollout bot for level checks and the fast-forward bench. It only acts after
+// ticks that produced events, which is when a fast-forwarding caller gets
+// control back: relaunch, and put the paddle under the straight-line landing
+// point if the ball is coming down.
+void rolloutBot(World& g, int now, int k)
+{
+    if (!g.ball.moving)
+    {
+        if (g.lives == 0 || g.bricks.aliveCount == 0)
+        {
+            useBuiltinBoard(g);
+            resetWorld(g, now, g.rng);
+        }
+        g.ball.moving = true;
+    }
+    float x;
+    if (predictLanding(g, &x, NULL)) movePaddleTo(g, x + (k % 5 - 2) * 0.04f);
+}
+
+// Play the tile on its own with the rollout bot; lives are topped up so only
+// the budget ends the run
+void genCheckTile(LevelGen& g, GenTile& t)
+{
+    World w = World();
+    w.ownedCells.resize((size_t)t.rows * t.cols);
+    int bricks = 0;
+    for (int i = 0; i < t.rows; ++i)
+        for (int j = 0; j < t.cols; ++j)
+        {
+            unsigned char c = g.canon[(size_t)(t.row + i) * g.canonCols + t.col + j];
+            w.ownedCells[(size_t)i * t.cols + j] = c;
+            if (BRICK_BREAKABLE(c)) bricks++;
+        }
+    t.trivial = t.tooHard = false;
+    t.cleared = 1.0f;
+    if (bricks == 0) return;    // an empty patch is part of the pattern
+    setBoard(w, w.ownedCells.data(), t.rows, t.cols, bricks);
+    resetWorld(w, 0, t.seed);
+    int tick = 0;
+    rolloutBot(w, 0, (int)t.seed);
+    while (tick < GEN_ROLLOUT_TICKS && w.bricks.aliveCount > 0)
+    {
+        tick += fastForward(w, tick * SIM_TICK_MS, GEN_ROLLOUT_TICKS - tick);
+        w.lives = 3;
+        if (w.eventCount > 0) rolloutBot(w, tick * SIM_TICK_MS, (int)t.seed);
+    }
+    t.cleared = 1.0f - (float)w.bricks.aliveCount / bricks;
+    t.trivial = w.bricks.aliveCount == 0 && tick < GEN_TRIVIAL_TICKS && bricks > 4;
+    t.tooHard = t.cleared < GEN_MIN_CLEAR;
+}
+
+// Worker item: fill and check one tile until it passes. If no seed passes,
+// the attempt that cleared the most without being trivial is kept.
+void genTileItem(void* ctx, int index)
+{
+    LevelGen& g = *(LevelGen*)ctx;
+    GenTile& t = g.tiles[index];
+    GenTile best = t;
+    best.cleared = -1.0f;
+    for (t.attempts = 0; t.attempts < GEN_TILE_ATTEMPTS; ++t.attempts)
+    {
+        t.seed = genHash(g.p.seed, (unsigned int)index, (unsigned int)t.attempts);
+        genFillTile(g, t);
+        genCheckTile(g, t);
+        if (!t.trivial && !t.tooHard) return;
+        if (!t.trivial && t.cleared > best.cleared) best = t;
+    }
+    if (best.cleared < 0.0f) return;    // all trivial: keep the last
+    best.attempts = t.attempts;
+    t = best;
+    genFillTile(g, t);
+}
+
+// Breakable bricks that the ball can't reach because steel walls them in
+int countSealedBricks(const unsigned char* cells, int rows, int cols)
+{
+    std::vector<unsigned char> seen((size_t)rows * cols, 0);
+    std::vector<int> stack;
+    for (int i = 0; i < rows; ++i)
+        for (int j = 0; j < cols; ++j)
+        {
+            int k = i * cols + j;
+            bool edge = i == 0 || j == 0 || i == rows - 1 || j == cols - 1;
+            if (edge && BRICK_TYPE(cells[k]) != BRICK_STEEL)
+            {
+                seen[k] = 1;
+                stack.push_back(k);
+            }
+        }
+    while (!stack.empty())
+    {
+        int k = stack.back();
+        stack.pop_back();
+        int i = k / cols, j = k % cols;
+        const int di[4] = { -1, 1, 0, 0 }, dj[4] = { 0, 0, -1, 1 };
+        for (int d = 0; d < 4; ++d)
+        {
+            int ni = i + di[d], nj = j + dj[d];
+            if (ni < 0 || nj < 0 || ni >= rows || nj >= cols) continue;
+            int n = ni * cols + nj;
+            if (seen[n] || (BRICK_HP(cells[n]) && BRICK_TYPE(cells[n]) == BRICK_STEEL)) continue;
+            seen[n] = 1;
+            stack.push_back(n);
+        }
+    }
+    int sealed = 0;
+    for (int k = 0; k < rows * cols; ++k)
+        if (!seen[k] && BRICK_BREAKABLE(cells[k])) sealed++;
+    return sealed;
+}
+
+// rows x cols cells into `cells`; returns the breakable brick count
+int generateLevel(std::vector<unsigned char>& cells, unsigned int seed, int rows, int cols,
+                  float difficulty, GenStats* stats)
+{
+    GenStats st;
+    memset(&st, 0, sizeof(st));
+    cells.assign((size_t)rows * cols, 0);
+    LevelGen g;
+    for (int attempt = 0; ; ++attempt)
+    {
+        g.p = genParams(genHash(seed, 0x6c766c, attempt), rows, cols, difficulty);
+        g.canonRows = g.p.symmetry == SYM_QUAD ? (rows + 1) / 2 : rows;
+        g.canonCols = g.p.symmetry != SYM_NONE ? (cols + 1) / 2 : cols;
+        g.canon.assign((size_t)g.canonRows * g.canonCols, 0);
+        g.tiles.clear();
+        for (int i = 0; i < g.canonRows; i += GEN_TILE)
+            for (int j = 0; j < g.canonCols; j += GEN_TILE)
+            {
+                GenTile t;
+                memset(&t, 0, sizeof(t));
+                t.row = i;
+                t.col = j;
+                t.rows = std::min(GEN_TILE, g.canonRows - i);
+                t.cols = std::min(GEN_TILE, g.canonCols - j);
+                g.tiles.push_back(t);
+            }
+        parallelFor((int)g.tiles.size(), genTileItem, &g);
+        for (size_t k = 0; k < g.tiles.size(); ++k)
+        {
+            st.tiles++;
+            st.tileRetries += g.tiles[k].attempts;
+            st.trivialTiles += g.tiles[k].trivial;
+            st.hardTiles += g.tiles[k].tooHard;
+        }
+
+        for (int i = 0; i < rows; ++i)
+            for (int j = 0; j < cols; ++j)
+            {
+                int ci = i < g.canonRows ? i : rows - 1 - i;
+                int cj = j < g.canonCols ? j : cols - 1 - j;
+                cells[(size_t)i * cols + j] = g.canon[(size_t)ci * g.canonCols + cj];
+            }
+        if (countSealedBricks(cells.data(), rows, cols) == 0) break;
+        if (attempt + 1 >= GEN_LEVEL_ATTEMPTS)
+        {
+            // out of seeds: steel becomes plain bricks, which can't seal anything
+            for (size_t k = 0; k < cells.size(); ++k)
+                if (BRICK_HP(cells[k]) && BRICK_TYPE(cells[k]) == BRICK_STEEL) cells[k] = BRICK_CELL(BRICK_NORMAL, 1);
+            st.steelStripped = true;
+            break;
+        }
+        st.levelRetries++;
+    }
+    for (size_t k = 0; k < cells.size(); ++k)
+        if (BRICK_BREAKABLE(cells[k])) st.bricks++;
+    if (stats) *stats = st;
+    return st.bricks;
+}
+
+// Endless mode (--endless): level n is generated from the run's seed, bigger
+// and harder as n grows. The next level is generated on a background thread
+// while the current one is played.
+void endlessSize(int level, int* rows, int* cols)
+{
+    *rows = std::min(5 + level, 24);
+    *cols = std::min(8 + 2 * level, 40);
+}
+
+void endlessGenerate(int level, std::vector<unsigned char>& cells)
+{
+    int rows, cols;
+    endlessSize(level, &rows, &cols);
+    generateLevel(cells, genHash(endless.seed, (unsigned int)level, 0), rows, cols,
+                  std::min(1.0f, level / 10.0f), NULL);
+}
+
+void endlessPrefetchMain(int level)
+{
+    endlessGenerate(level, endless.next);
+}
+
+void waitEndless()
+{
+    if (endless.thread.joinable()) endless.thread.join();
+}
+
+void setGeneratedBoard(World& w, const std::vector<unsigned char>& cells, int level)
+{
+    int rows, cols, breakable = 0;
+    endlessSize(level, &rows, &cols);
+    w.ownedCells = cells;
+    for (size_t k = 0; k < cells.size(); ++k)
+        if (BRICK_BREAKABLE(cells[k])) breakable++;
+    setBoard(w, w.ownedCells.data(), rows, cols, breakable);
 }
 
-// Win screen overlay
-void drawWinScreenOverlay()
+void startEndless(World& w)
+{
+    waitEndless();
+    if (endless.first.empty()) endlessGenerate(0, endless.first);
+    endless.level = 0;
+    setGeneratedBoard(w, endless.first, 0);
+    endless.thread = std::thread(endlessPrefetchMain, 1);
+}
 
+bool advanceEndless(World& w, int now)
 {
-    // dim background
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glColor4f(0, 0, 0, 0.6f);
-    glBegin(GL_QUADS);
-    glVertex2f(-1,-1);
-    glVertex2f(1,-1);
-    glVertex2f(1,1);
-    glVertex2f(-1,1);
-    glEnd();
-    glDisable(GL_BLEND);
- // panel
-    float panelW = 0.6f, panelH = 0.5f;
-    glColor3f(0.1f, 0.1f, 0.15f);
-    glBegin(GL_QUADS);
-    glVertex2f(-panelW/2, panelH/2);
-    glVertex2f(panelW/2, panelH/2);
-    glVertex2f(panelW/2, -panelH/2);
-    glVertex2f(-panelW/2, -panelH/2);
-    glEnd();
+    waitEndless();    // normally finished long ago
+    endless.level++;
+    setGeneratedBoard(w, endless.next, endless.level);
+    startRound(w, now);
+    endless.thread = std::thread(endlessPrefetchMain, endless.level + 1);
+    return true;
+}
 
- // title
-    glColor3f(1,1,0.2f);
-    drawText(-0.18f, 0.15f, "🏆 YOU WIN! 🏆");
+// -------------------------- Autopilot --------------------------
+// Plays the attract demo behind the menu and, with --assist, holds the paddle
+// while the player's hand is off it. The demo is opt-in (--attract): it keeps
+// the tick loop and the worker pool busy on a menu that would otherwise sleep.
+// A decision picks where on the paddle face to take the ball next. Every candidate is played ahead on a clone of the game:
+// the paddle is put at the landing point plus that offset when the ball comes
+// down, and the rollout bot plays on from the first hit. A batch runs one
+// rollout per candidate on the worker pool, all with the same RNG seed, and
+// batches with fresh seeds run until the time budget is spent; the best mean
+// wins. Rollouts fast-forward between events, so a few hundred fit in a frame.
+// Between decisions the live paddle heads for the chosen spot at a hand's pace.
+#define AUTO_CANDIDATES 16
+#define AUTO_MAX_BATCHES 32         // rollouts per candidate and decision, at most
+#define AUTO_HORIZON_TICKS 240
+#define AUTO_BUDGET_US 3000.0
+#define AUTO_REPLAN_TICKS 8
+#define AUTO_LIFE_VALUE 1000        // points a lost ball costs a rollout
+const float AUTO_PADDLE_SPEED = 0.05f;  // per tick, a bit under a key press
+#define ASSIST_IDLE_MS 400
+#define ATTRACT_SERVE_TICKS 45
+
+struct AutoCandidate
+{
+    float offset;       // from the landing point
+    int runs;
+    long long total;    // summed rollout values
+};
 
-// final score
-    char buffer[32];
-    sprintf(buffer, "Final Score: %d", score);
-    drawText(-0.15f, 0.05f, buffer);
+struct Autopilot
+{
+    World clones[AUTO_CANDIDATES];  // one per rollout of a batch
+    AutoCandidate cand[AUTO_CANDIDATES];
+    int order[AUTO_CANDIDATES];     // reachable candidates, one per batch item
+    int count;
+    const World* src;
+    int now;
+    unsigned int seed;
+    int batch;
+    float offset;                   // chosen
+    int replanIn;                   // ticks
+    // for --bench
+    int decisions, overFrame;
+    long long rollouts;
+    double totalUs, worstUs;
+};
+Autopilot g_auto;
+
+// Copy a world for a rollout. The cells always go into the clone's own vector,
+// which reserveAutopilot has sized, so nothing is allocated.
+void cloneWorld(World& dst, const World& src)
+{
+    dst = src;
+    if (src.bricks.cell != src.ownedCells.data())
+        dst.ownedCells.assign(src.bricks.cell, src.bricks.cell + (size_t)src.bricks.rows * src.bricks.cols);
+    dst.bricks.cell = dst.ownedCells.data();
+}
 
-    // instructions
-    drawText(-0.22f, -0.1f, "Click LEFT MOUSE to play again");
-    drawText(-0.22f, -0.18f, "Press ESC to exit");
+void reserveAutopilot(const World& w)
+{
+    size_t n = std::max(w.ownedCells.size(), (size_t)w.bricks.rows * w.bricks.cols);
+    for (int i = 0; i < AUTO_CANDIDATES; ++i) g_auto.clones[i].ownedCells.reserve(n);
+    g_auto.replanIn = 0;
 }
 
-// GameOverOverlay function name
-void drawGameOverOverlay()
+// Worker item: one rollout of candidate order[i]. Its value is the score
+// gained, less AUTO_LIFE_VALUE if the ball is lost.
+void autoRolloutItem(void* ctx, int i)
 {
-    drawGameOverScreenOverlay();
+    Autopilot& a = *(Autopilot*)ctx;
+    AutoCandidate& c = a.cand[a.order[i]];
+    World& w = a.clones[i];
+    cloneWorld(w, *a.src);
+    w.rng = genHash(a.seed, (unsigned int)a.batch, 0) | 1u;
+    int k = (int)(genHash(a.seed, (unsigned int)a.batch, 1) % 5);
+    int score = w.score, lives = w.lives, t = 0;
+    bool hit = false;
+    while (t < AUTO_HORIZON_TICKS && w.lives == lives && w.ball.moving)
+    {
+        float x;
+        if (hit) rolloutBot(w, a.now + t * SIM_TICK_MS, k);
+        else if (predictLanding(w, &x, NULL)) movePaddleTo(w, x + c.offset);
+        // a rising ball may turn at the top wall without an event; look again there
+        int chunk = AUTO_HORIZON_TICKS - t;
+        float vy = toF(w.ball.dy * w.ball.speedMul);
+        if (vy > 0.0f) chunk = std::min(chunk, std::max(1, (int)((w.bricks.ceilY - toF(w.ball.y)) / vy) + 1));
+        t += fastForward(w, a.now + t * SIM_TICK_MS, chunk);
+        for (int e = 0; e < w.eventCount; ++e)
+            if (w.events[e].kind == EV_PADDLE_HIT) hit = true;
+    }
+    c.total += (w.score - score) - (lives - w.lives) * AUTO_LIFE_VALUE;
+    c.runs++;
 }
 
-void display()
+// Pick the paddle offset for the next catch, within AUTO_BUDGET_US
+void planPaddle(const World& w, int now)
 {
-    glClear(GL_COLOR_BUFFER_BIT);
+    Autopilot& a = g_auto;
+    double t0 = nowUs();
+    float half = toF(w.paddle.width) / 2, px = toF(w.paddle.x);
+    float x, ticks;
+    bool falling = predictLanding(w, &x, &ticks);
+    a.count = 0;
+    for (int pass = 0; pass < 2 && a.count == 0; ++pass)
+        for (int i = 0; i < AUTO_CANDIDATES; ++i)
+        {
+            AutoCandidate& c = a.cand[i];
+            c.offset = 0.9f * half * (2.0f * i / (AUTO_CANDIDATES - 1) - 1.0f);
+            c.runs = 0;
+            c.total = 0;
+            // skip spots the paddle can't get to in time, unless that is all of them
+            float goal = std::max(-1.0f + half, std::min(1.0f - half, x + c.offset));
+            if (pass == 1 || !falling || fabsf(goal - px) <= AUTO_PADDLE_SPEED * ticks)
+                a.order[a.count++] = i;
+        }
 
-    drawBackground();
+    a.src = &w;
+    a.now = now;
+    a.seed = genHash(w.rng, (unsigned int)now, (unsigned int)a.decisions);
+    a.batch = 0;
+    do
+    {
+        parallelFor(a.count, autoRolloutItem, &a);
+        a.batch++;
+    } while (a.batch < AUTO_MAX_BATCHES && nowUs() - t0 < AUTO_BUDGET_US);
 
-    // Draw gameplay elements only when playing or paused
-    if (state == STATE_PLAYING || state == STATE_PAUSED)
+    // best mean; ties go to the spot nearer the middle of the paddle
+    int best = a.order[0];
+    for (int n = 1; n < a.count; ++n)
     {
-        drawBricks();
-        drawBallTrail();
-        drawPaddle();
-        drawBallGlow();
-        drawBallCore();
-        drawPowerUps();
+        const AutoCandidate& c = a.cand[a.order[n]];
+        long long lhs = c.total * a.cand[best].runs, rhs = a.cand[best].total * c.runs;
+        if (lhs > rhs || (lhs == rhs && fabsf(c.offset) < fabsf(a.cand[best].offset)))
+            best = a.order[n];
     }
+    a.offset = a.cand[best].offset;
+    a.replanIn = AUTO_REPLAN_TICKS;
+
+    double us = nowUs() - t0;
+    a.decisions++;
+    a.rollouts += (long long)a.batch * a.count;
+    a.totalUs += us;
+    a.worstUs = std::max(a.worstUs, us);
+    if (us > SIM_TICK_MS * 1000.0) a.overFrame++;
+    histRecord(H_AUTOPILOT_US, (unsigned int)us);
+    histRecord(H_AUTOPILOT_ROLLOUTS, (unsigned int)(a.batch * a.count));
+}
 
-    // HUD always on top
-    drawHUD();
-
-    // overlay depending on state
-    switch (state)
+// Move w's paddle for the coming tick, planning first if the last tick had
+// events or the plan is old
+void autopilotTick(World& w, int now)
+{
+    Autopilot& a = g_auto;
+    if (!w.ball.moving)
     {
-    case STATE_MENU:
-        drawMenuScreenOverlay();
-        break;
-    case STATE_INSTRUCTIONS:
-        drawInstructionsOverlay();
-        break;
-    case STATE_PAUSED:
-        drawPauseMenuOverlay();
-        break;
-    case STATE_GAMEOVER:
-        drawGameOverOverlay();
-        break;
-    case STATE_WIN:
-        drawWinScreenOverlay();
-        break;
-    default:
-        break;
+        a.replanIn = 0;
+        return;
     }
+    if (--a.replanIn <= 0 || w.eventCount > 0) planPaddle(w, now);
+    // follow the ball on the way up, head for the catch on the way down
+    float x, px = toF(w.paddle.x);
+    float goal = predictLanding(w, &x, NULL) ? x + a.offset : toF(w.ball.x);
+    movePaddleTo(w, px + std::max(-AUTO_PADDLE_SPEED, std::min(AUTO_PADDLE_SPEED, goal - px)));
+}
 
-    // fireworks only for WIN
-    if (state == STATE_WIN) drawFireworks();
+int attractServeIn = 0;
 
-    glutSwapBuffers();
+// One tick of the demo behind the menu. It is silent, starts over when it
+// ends and doesn't count towards the metrics.
+void stepAttract(int now)
+{
+    World& w = g_attract;
+    if (!attractLive || w.lives == 0 || w.bricks.aliveCount == 0)
+    {
+        useBuiltinBoard(w);
+        resetWorld(w, now, (unsigned int)now);
+        reserveAutopilot(w);
+        clearAnims();
+        attractLive = true;
+    }
+    if (w.ball.moving) attractServeIn = ATTRACT_SERVE_TICKS;
+    else if (--attractServeIn <= 0) w.ball.moving = true;
+    autopilotTick(w, now);
+    stepWorld(w, now);
+    for (int i = 0; i < w.eventCount; ++i)
+    {
+        const WorldEvent& e = w.events[i];
+        if (e.kind == EV_BRICK_DESTROYED) startAnim(ANIM_BRICK_FADE, e.a, e.b, 1.25f);
+        else if (e.kind == EV_BRICK_DAMAGED) startAnim(ANIM_FLASH, e.a, e.b, 6.0f);
+        else if (e.kind == EV_BRICK_EXPLODED)
+        {
+            startAnim(ANIM_SHAKE, -1, -1, 4.0f);
+            startBlastFades(w, e);
+        }
+    }
+}
+
+// --assist: the autopilot takes over once the hand has been off the paddle
+// for ASSIST_IDLE_MS; launching stays with the player
+void assistTick(World& w, int now)
+{
+    if (nowUs() - handUs < ASSIST_IDLE_MS * 1000.0) return;
+    if (pointerActive) releasePointer();
+    autopilotTick(w, now);
 }
 
-void spawnPowerUp(float x, float y, PowerType t)
+// -------------------------- Benchmarks (--bench) --------------------------
+// Headless: no window or GL context is created.
+
+// 256 overlapping voices, mixed block by block; budget is 1 ms per 10 ms block
+bool benchAudioMix()
 {
-    for (int i=0; i<ROWS*COLS; i++)
+    static Mixer m;
+    initSounds();
+    m.head.store(0);
+    m.tail.store(0);
+    m.voiceCount = 0;
+
+    const int blocks = 2000;
+    double mixUs = 0.0;
+    for (int b = 0; b < blocks; ++b)
     {
-        if (!powerUps[i].visible)
+        // keep the voice pool full, as a busy scene would
+        while (m.voiceCount + (int)(m.head.load() - m.tail.load()) < MAX_VOICES)
         {
-            powerUps[i].visible = true;
-            powerUps[i].type = t;
-            powerUps[i].x = x;
-            powerUps[i].y = y;
-            powerUps[i].vy = -0.008f - (rand()%8)/1000.0f;
-            break;
+            AudioCmd c = { AUDIO_PLAY, (unsigned char)SND_WIN, 0.01f, 0.01f };
+            if (!pushAudioCmd(m, c)) break;
         }
+        double t0 = nowUs();
+        drainAudioCmds(m);
+        mixBlock(m);
+        mixUs += nowUs() - t0;
     }
+    double perBlock = mixUs / blocks;
+    bool ok = perBlock < 1000.0;
+    printf("audio mix: %d voices, %.1f us per %d-sample block (budget 1000 us) %s\n",
+           MAX_VOICES, perBlock, AUDIO_BLOCK, ok ? "OK" : "FAIL");
+    return ok;
 }
-void update(int value)
+
+// Level switch on a 100k-brick campaign: the prefetched swap vs. mapping and
+// validating on the spot. The swap is what the game thread pays after a win.
+bool benchLevelSwitch()
 {
-    int now = glutGet(GLUT_ELAPSED_TIME);
+    const int rows = 250, cols = 400;
+    const char* paths[2] = { "bench_level_a.dxl", "bench_level_b.dxl" };
+    for (int i = 0; i < 2; ++i)
+        if (!makeLevelFile(paths[i], rows, cols))
+        {
+            printf("level switch: cannot write %s\n", paths[i]);
+            return false;
+        }
+    campaign.count = 0;
+    addCampaignLevel(paths[0]);
+    addCampaignLevel(paths[1]);
+
+    static World w;
+    double t0 = nowUs();
+    bool ok = enterCampaignLevel(0);
+    double syncUs = nowUs() - t0;
+    waitPrefetch();    // the level is being played meanwhile
+
+    t0 = nowUs();
+    ok = ok && advanceCampaign(w, 0);
+    double swapUs = nowUs() - t0;
+    ok = ok && w.bricks.rows == rows && w.bricks.cols == cols;
+
+    stopCampaign();
+    campaign.count = 0;
+    remove(paths[0]);
+    remove(paths[1]);
+    ok = ok && swapUs < 1000.0;
+    printf("level switch: %d bricks, map+validate %.0f us, prefetched swap %.1f us %s\n",
+           rows * cols, syncUs, swapUs, ok ? "OK" : "FAIL");
+    return ok;
+}
 
-    // If not playing, skip ball movement (but keep redisplay and timer)
-    if (state != STATE_PLAYING)
+// Fixed 5x8 board code vs. the runtime-sized fallback on the same board:
+// brick collision per tick and brick vertex building per frame.
+template <class G>
+double benchCollision(const G& g, World& w, int iters, int* checksum)
+{
+    unsigned int seed = 777;
+    double t0 = nowUs();
+    for (int n = 0; n < iters; ++n)
     {
-        glutPostRedisplay();
-        glutTimerFunc(16, update, 0);
-        return;
+        if ((n & 63) == 0)
+        {
+            memset(w.bricks.cell, 1, ROWS*COLS);
+            w.bricks.aliveCount = ROWS*COLS;
+            w.powerUps.count = 0;
+        }
+        seed = seed * 1664525u + 1013904223u;
+        w.ball.x = ((seed >> 8) & 0xffff) / 65535.0f * 1.9f - 0.95f;
+        w.ball.y = ((seed >> 4) & 0xfff) / 4095.0f * 1.9f - 0.95f;   // anywhere in the playfield
+        w.ball.dx = 0.008f;
+        w.ball.dy = 0.01f;
+        w.eventCount = 0;
+        brickCollisionImpl(w, g);
+        *checksum += w.score + (w.ball.dx > 0) + (w.ball.dy > 0);
     }
+    return (nowUs() - t0) * 1000.0 / iters;
+}
 
-    // Speed ramp over time
-    if (now - lastSpeedIncreaseCheckMs >= SPEED_INCREASE_INTERVAL_MS)
+template <class G>
+double benchBrickVerts(const G& g, const World& w, int iters)
+{
+    double t0 = nowUs();
+    for (int n = 0; n < iters; ++n)
     {
-        lastSpeedIncreaseCheckMs = now;
-        ballDX *= SPEED_INCREASE_FACTOR;
-        ballDY *= SPEED_INCREASE_FACTOR;
+        gl3VertCount = 0;
+        gl3BricksImpl(w, g);
     }
+    return (nowUs() - t0) * 1000.0 / iters;
+}
 
-    // Update trail buffer
-    for (int i = TRAIL_LEN - 1; i > 0; --i)
+bool benchBoardSpecialisation()
+{
+    static World w;
+    useBuiltinBoard(w);
+    resetWorld(w, 0, 1);
+    int sumFixed = 0, sumRuntime = 0;
+    const int iters = 2000000;
+
+    w.score = 0;
+    double fixedNs = benchCollision(FixedBoard<ROWS, COLS>(), w, iters, &sumFixed);
+    w.score = 0;
+    w.rng = 1;
+    double runtimeNs = benchCollision(RuntimeBoard(w.bricks), w, iters, &sumRuntime);
+
+    memset(w.bricks.cell, 1, ROWS*COLS);
+    double fixedVertNs = benchBrickVerts(FixedBoard<ROWS, COLS>(), w, 20000);
+    double runtimeVertNs = benchBrickVerts(RuntimeBoard(w.bricks), w, 20000);
+    gl3VertCount = 0;
+
+    bool ok = sumFixed == sumRuntime;
+    printf("board 5x8 collision: fixed %.1f ns, runtime %.1f ns per tick (%.2fx)%s\n",
+           fixedNs, runtimeNs, runtimeNs / fixedNs, ok ? "" : " RESULTS DIFFER");
+    printf("board 5x8 brick verts: fixed %.0f ns, runtime %.0f ns per frame (%.2fx)\n",
+           fixedVertNs, runtimeVertNs, runtimeVertNs / fixedVertNs);
+    return ok;
+}
+
+// Full boards ten and a hundred screens tall, both at the smallest brick size,
+// with the camera at the bottom, the middle and the top of each. Culled, the
+// view holds the same rows wherever it is, so the taller board has to draw the
+// same number of vertices in about the same time; drawn whole it would cost
+// ten times as much.
+#define TALL_ROWS_PER_SCREEN 40     // rows of the same height at TALL_MIN_SCALE
+#define TALL_MAX_SLOWDOWN 1.25      // taller board's brick verts against the shorter's
+bool benchTallBoard()
+{
+    const int cols = 8, screens[2] = { 10, 100 }, iters = 500, runs = 5;
+    const float stops[3] = { 0.0f, 0.5f, 1.0f };    // camera height over its range
+    static World w[2];
+    for (int b = 0; b < 2; ++b)
     {
-        trailX[i] = trailX[i - 1];
-        trailY[i] = trailY[i - 1];
+        int rows = screens[b] * TALL_ROWS_PER_SCREEN;
+        w[b].ownedCells.assign(rows * cols, BRICK_CELL(BRICK_NORMAL, 1));
+        setBoard(w[b], w[b].ownedCells.data(), rows, cols, rows * cols);
     }
-    trailX[0] = ballX;
-    trailY[0] = ballY;
 
-    if (lives > 0 && ballMoving)
+    bool ok = true;
+    for (int b = 0; b < 2; ++b)
+        ok = ok && fabsf((w[b].bricks.ceilY + 1.0f) * 0.5f - screens[b]) < 0.5f;
+    double ns[2] = { 0.0, 0.0 };
+    int verts[2][3];
+    for (int k = 0; k < 3; ++k)
     {
-        // Move ball
-        ballX += ballDX * ballSpeedMultiplier;
-        ballY += ballDY * ballSpeedMultiplier;
+        double best[2] = { 1e30, 1e30 };
+        for (int r = 0; r < runs; ++r)
+            for (int b = 0; b < 2; ++b)
+            {
+                float range = w[b].bricks.ceilY - 1.0f, want = stops[k] * range;
+                w[b].ball.y = want + CAMERA_BAND_HIGH;
+                cameraY = 0.0f;
+                updateCamera(w[b]);
+                ok = ok && fabsf(cameraY - want) <= 1e-4f * range;
+                best[b] = std::min(best[b], benchBrickVerts(RuntimeBoard(w[b].bricks), w[b], iters));
+                verts[b][k] = gl3VertCount;
+            }
+        for (int b = 0; b < 2; ++b) ns[b] = std::max(ns[b], best[b]);
+        // a row more or less may come into view depending on the scroll
+        ok = ok && abs(verts[1][k] - verts[0][k]) <= cols * 6;
+    }
+    ok = ok && ns[1] < ns[0] * TALL_MAX_SLOWDOWN;
+    printf("tall board: %d vs %d screens, brick verts %.0f vs %.0f ns culled (%.2fx), "
+           "%d/%d/%d vs %d/%d/%d verts %s\n",
+           screens[1], screens[0], ns[1], ns[0], ns[1] / ns[0],
+           verts[1][0], verts[1][1], verts[1][2], verts[0][0], verts[0][1], verts[0][2], ok ? "OK" : "FAIL");
+    cameraY = 0.0f;
+    gl3VertCount = 0;
+    return ok;
+}
 
-        // Wall collisions
-        if (ballX + ballRadius > 1.0f)
+// The game loop without a window: input, tick and the legacy frame (recorded
+// and sorted, not submitted) on g_world, with the rollout bot at the paddle and
+// every ended game restarted. Each frame also feeds one scripted event through
+// the input handlers in turn: pointer motion, arrow key, paddle key, click.
+// After warm-up none of input, tick and draw may allocate. Only checked in
+// -DDXB_ALLOC_TRACK builds.
+bool benchFrameAllocations()
+{
+#ifndef DXB_ALLOC_TRACK
+    printf("frame allocations: not tracked (build with -DDXB_ALLOC_TRACK)\n");
+    return true;
+#else
+    const int warmup = 300, frames = 30000;
+    int start = glutGet(GLUT_ELAPSED_TIME), games = 0;
+    initUi();
+    for (int f = 0; f < warmup + frames; ++f)
+    {
+        if (f == warmup) allocArm();
+        int now = start + f * SIM_TICK_MS;
         {
-            ballX = 1.0f - ballRadius;
-            ballDX = -fabs(ballDX);
+            AllocScope scope(PHASE_INPUT);
+            if (state != STATE_PLAYING)
+            {
+                keyboardASCII(' ', 0, 0);   // start, continue or restart
+                games++;
+            }
+            bool left = (f / 4) % 2;
+            switch (f % 4)
+            {
+            case 0: mouseMove(g_winW / 2 + (left ? -40 : 40), g_winH / 2); break;
+            case 1: keyboardSpecial(left ? GLUT_KEY_LEFT : GLUT_KEY_RIGHT, 0, 0); break;
+            case 2: keyboardASCII(left ? 'a' : 'd', 0, 0); break;
+            case 3:
+                mouseClick(GLUT_LEFT_BUTTON, GLUT_DOWN, g_winW / 2, g_winH / 2);
+                mouseClick(GLUT_LEFT_BUTTON, GLUT_UP, g_winW / 2, g_winH / 2);
+                break;
+            }
+            rolloutBot(g_world, now, f);
         }
-        if (ballX - ballRadius < -1.0f)
         {
-            ballX = -1.0f + ballRadius;
-            ballDX = fabs(ballDX);
+            AllocScope scope(PHASE_TICK);
+            stepWorld(g_world, now);
+            session.playMs += SIM_TICK_MS;
+            handleWorldEvents(g_world);
+            countStateChange();
         }
-        if (ballY + ballRadius > 1.0f)
         {
-            ballY = 1.0f - ballRadius;
-            ballDY = -fabs(ballDY);
+            AllocScope scope(PHASE_DRAW);
+            updateCamera(g_world);
+            cmdRecording = deferText = true;
+            recordFrame(g_world, playfieldWorld());
+            cmdSortRuns();
+            cmdList.clear();
+            cmdVerts.clear();
+            pendingTextCount = 0;
+            cmdRecording = deferText = false;
         }
+    }
+    bool ok = allocReport();
+    ok = ok && allocStats.count[PHASE_INPUT][1].load() == 0;
+    printf("frame allocations: %d frames over %d games, %llu in input, %llu in the tick and %llu in the draw "
+           "after warm-up %s\n",
+           frames, games, allocStats.count[PHASE_INPUT][1].load(), allocStats.count[PHASE_TICK][1].load(),
+           allocStats.count[PHASE_DRAW][1].load(), ok ? "OK" : "FAIL");
+    state = STATE_MENU;
+    return ok;
+#endif
+}
 
-        // Paddle collision
-        if (ballY - ballRadius <= -0.95f + paddleHeight &&
-                ballY - ballRadius >= -0.95f - 0.02f &&
-                ballX >= paddleX - paddleWidth/2 - 0.02f &&
-                ballX <= paddleX + paddleWidth/2 + 0.02f &&
-                ballDY < 0.05f)
-        {
-            float hitPos = (ballX - paddleX) / (paddleWidth / 2);
-            float angle = hitPos * (3.14159f / 3.5f);  // wider angle control
-            float speed = sqrtf(ballDX * ballDX + ballDY * ballDY);
-            ballDX = speed * sinf(angle);
-            ballDY = fabsf(speed * cosf(angle));
-            if (ballDY < 0) ballDY = -ballDY;
-        }
+// Whole-game stepping with a scripted paddle, for comparing the float and
+// DXB_FIXED_PHYSICS builds. The state hash must match between any two builds
+// of the fixed-point mode.
+bool benchPhysics()
+{
+    const int worlds = 64, ticks = 20000;
+    static World w[worlds];
+    for (int k = 0; k < worlds; ++k)
+    {
+        useBuiltinBoard(w[k]);
+        resetWorld(w[k], 0, 1000 + k);
+    }
 
-        // Brick collisions & fade animation
-        for (int i = 0; i < ROWS; i++)
+    unsigned int hash = 2166136261u;
+    double t0 = nowUs();
+    for (int t = 0; t < ticks; ++t)
+    {
+        int now = t * 16;
+        for (int k = 0; k < worlds; ++k)
         {
-            for (int j = 0; j < COLS; j++)
+            World& g = w[k];
+            if (!g.ball.moving)
             {
-                if (bricks[i][j])
-                {
-                    float x = brickStartX + j * (brickWidth + brickSpacingX);
-                    float y = brickStartY - i * (brickHeight + brickSpacingY);
-
-                    if (ballX + ballRadius > x && ballX - ballRadius < x + brickWidth &&
-                            ballY + ballRadius > y - brickHeight && ballY - ballRadius < y)
-                    {
-                        // destroy brick & trigger fade
-                        bricks[i][j] = 0;
-                        brickFade[i][j] = 1.0f;
-                        score += 10;
-
-                        // Collision response
-                        float overlapLeft   = (ballX + ballRadius) - x;
-                        float overlapRight  = (x + brickWidth) - (ballX - ballRadius);
-                        float overlapTop    = (y) - (ballY - ballRadius);
-                        float overlapBottom = (ballY + ballRadius) - (y - brickHeight);
-
-                        bool invertX = (overlapLeft < overlapTop && overlapLeft < overlapBottom) ||
-                                       (overlapRight < overlapTop && overlapRight < overlapBottom);
-                        if (invertX) ballDX = -ballDX;
-                        else         ballDY = -ballDY;
-
-                        // Random powerup spawn
-                        if (rand() % 4 == 0)
-                            spawnPowerUp(ballX, ballY, (PowerType)(rand() % 3));
-                    }
-                }
-
-                // Brick fade update
-                if (brickFade[i][j] > 0.0f)
+                if (g.lives == 0 || g.bricks.aliveCount == 0)
                 {
-                    brickFade[i][j] -= 0.02f;
-                    if (brickFade[i][j] < 0.0f) brickFade[i][j] = 0.0f;
+                    useBuiltinBoard(g);
+                    resetWorld(g, now, g.rng);
                 }
+                g.ball.moving = true;
             }
+            // follow the ball, aiming off-centre to get a spread of angles
+            movePaddleTo(g, g.ball.x + ((t / 97 + k) % 5 - 2) * 0.04f);
+            stepWorld(g, now);
         }
+    }
+    double nsPerTick = (nowUs() - t0) * 1000.0 / ((double)worlds * ticks);
 
-// Check win
-        bool allCleared = true;
-        for (int i = 0; i < ROWS && allCleared; i++)
-            for (int j = 0; j < COLS; j++)
-                if (bricks[i][j])
-                {
-                    allCleared = false;
-                    break;
-                }
-        if (allCleared)
-        {
-            state = STATE_WIN;
-            ballMoving = false;
-        }
+    for (int k = 0; k < worlds; ++k)
+    {
+        real state[4] = { w[k].ball.x, w[k].ball.y, w[k].ball.dx, w[k].ball.dy };
+        unsigned char bytes[sizeof(state)];
+        memcpy(bytes, state, sizeof(state));
+        for (size_t n = 0; n < sizeof(bytes); ++n) hash = (hash ^ bytes[n]) * 16777619u;
+        hash = (hash ^ (unsigned int)w[k].score) * 16777619u;
+        hash = (hash ^ levelChecksum(w[k].bricks.cell, ROWS*COLS)) * 16777619u;
+    }
+    printf("physics (%s): %.1f ns per world tick, state hash %08x\n", PHYSICS_NAME, nsPerTick, hash);
+    return true;
+}
 
-        // Ball fall (lose life)
-        if (ballY < -1.1f)
+unsigned int hashBytes(unsigned int h, const void* data, size_t n)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < n; ++i) h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+// Everything stepWorld reads or writes
+unsigned int worldStateHash(const World& w)
+{
+    unsigned int h = 2166136261u;
+    const Ball& b = w.ball;
+    h = hashBytes(h, &b.x, sizeof(b.x));
+    h = hashBytes(h, &b.y, sizeof(b.y));
+    h = hashBytes(h, &b.dx, sizeof(b.dx));
+    h = hashBytes(h, &b.dy, sizeof(b.dy));
+    h = hashBytes(h, &b.speedMul, sizeof(b.speedMul));
+    h = hashBytes(h, &b.moving, sizeof(b.moving));
+    h = hashBytes(h, b.trailX, sizeof(b.trailX));
+    h = hashBytes(h, b.trailY, sizeof(b.trailY));
+    h = hashBytes(h, &w.paddle.x, sizeof(w.paddle.x));
+    h = hashBytes(h, &w.paddle.width, sizeof(w.paddle.width));
+    const PowerUpStore& ps = w.powerUps;
+    h = hashBytes(h, &ps.count, sizeof(ps.count));
+    h = hashBytes(h, ps.x, ps.count * sizeof(ps.x[0]));
+    h = hashBytes(h, ps.y, ps.count * sizeof(ps.y[0]));
+    h = hashBytes(h, ps.vy, ps.count * sizeof(ps.vy[0]));
+    h = hashBytes(h, ps.type, ps.count * sizeof(ps.type[0]));
+    h = hashBytes(h, &w.effects.count, sizeof(w.effects.count));
+    h = hashBytes(h, w.effects.heap, w.effects.count * sizeof(w.effects.heap[0]));
+    int misc[4] = { w.score, w.lives, (int)w.rng, w.bricks.aliveCount };
+    h = hashBytes(h, misc, sizeof(misc));
+    return hashBytes(h, w.bricks.cell, (size_t)w.bricks.rows * w.bricks.cols);
+}
+
+// A board several screens tall with bricks along its top row only: away from
+// the paddle, the walls and that row there is nothing to hit, so most ticks
+// cross empty space
+#define SPARSE_ROWS 120
+void useSparseBoard(World& w)
+{
+    w.ownedCells.assign(SPARSE_ROWS * COLS, 0);
+    for (int j = 0; j < COLS; ++j) w.ownedCells[j] = BRICK_CELL(BRICK_NORMAL, 9);
+    setBoard(w, w.ownedCells.data(), SPARSE_ROWS, COLS, COLS);
+}
+
+// The same rollouts stepped tick by tick and fast-forwarded between events.
+// Final states have to match exactly. Each way is timed a few times and the
+// best run kept, so a stall on a busy machine doesn't decide the ratio;
+// returns the speed-up.
+#define FF_MAX_WORLDS 128
+#define FF_RUNS 3
+double fastForwardRollouts(const char* name, void (*board)(World&), int worlds, int ticks, bool* ok)
+{
+    static World a[FF_MAX_WORLDS], b[FF_MAX_WORLDS];
+    auto play = [&](World* ws, bool fast, int* events)
+    {
+        for (int k = 0; k < worlds; ++k)
         {
-            lives--;
-            if (lives > 0) resetBall();
-            else
-            {
-                ballMoving = false;
-                state = STATE_GAMEOVER;
-            }
+            board(ws[k]);
+            resetWorld(ws[k], 0, 2000 + k);
         }
-
-        // Powerups fall & collect
-        for (int i = 0; i < ROWS * COLS; i++)
+        *events = 0;
+        double t0 = nowUs();
+        for (int k = 0; k < worlds; ++k)
         {
-            if (!powerUps[i].visible) continue;
-            powerUps[i].y += powerUps[i].vy;
-
-            // Paddle collect
-            if (powerUps[i].y <= -0.95f + paddleHeight &&
-                    powerUps[i].x >= paddleX - paddleWidth/2 - 0.03f &&
-                    powerUps[i].x <= paddleX + paddleWidth/2 + 0.03f)
+            World& g = ws[k];
+            rolloutBot(g, 0, k);
+            for (int t = 0; t < ticks; )
             {
-                if (powerUps[i].type == POWER_EXTRA_LIFE) lives++;
-                else if (powerUps[i].type == POWER_FASTER_BALL) ballSpeedMultiplier *= 1.5f;
-                else if (powerUps[i].type == POWER_WIDER_PADDLE)
+                if (fast) t += fastForward(g, t * SIM_TICK_MS, ticks - t);
+                else stepWorld(g, t++ * SIM_TICK_MS);
+                if (g.eventCount > 0)
                 {
-                    if (!paddleWidened)
-                    {
-                        paddleWidened = true;
-                        paddleWidth *= 1.6f;
-                        if (paddleWidth > PADDLE_MAX_WIDTH) paddleWidth = PADDLE_MAX_WIDTH;
-                        paddleWidenEndTimeMs = now + PADDLE_WIDEN_DURATION_MS;
-                    }
-                    else
-                    {
-                        paddleWidenEndTimeMs = now + PADDLE_WIDEN_DURATION_MS;
-                    }
+                    (*events)++;
+                    rolloutBot(g, t * SIM_TICK_MS, k);
                 }
-                score += 50;
-                powerUps[i].visible = false;
             }
-
-            // Missed
-            if (powerUps[i].y < -1.2f) powerUps[i].visible = false;
-        }
-
-        // Paddle widen expire
-        if (paddleWidened && now >= paddleWidenEndTimeMs)
-        {
-            paddleWidened = false;
-            paddleWidth /= 1.6f;
-            if (paddleWidth < PADDLE_MIN_WIDTH) paddleWidth = PADDLE_MIN_WIDTH;
         }
-    } // end ballMoving
+        return nowUs() - t0;
+    };
 
-    glutPostRedisplay();
-    glutTimerFunc(16, update, 0);
+    double stepUs = 1e30, fastUs = 1e30;
+    int eventsA = 0, eventsB = 0;
+    bool same = true;
+    for (int r = 0; r < FF_RUNS; ++r)
+    {
+        stepUs = std::min(stepUs, play(a, false, &eventsA));
+        fastUs = std::min(fastUs, play(b, true, &eventsB));
+        same = same && eventsA == eventsB;
+        for (int k = 0; k < worlds && same; ++k)
+            same = worldStateHash(a[k]) == worldStateHash(b[k]);
+    }
+    *ok = *ok && same;
+    double stepNs = stepUs * 1000.0 / ((double)worlds * ticks);
+    double fastNs = fastUs * 1000.0 / ((double)worlds * ticks);
+    printf("fast-forward (%s, %s board): %.1f ns per tick stepped, %.1f ns skipped (%.1fx), %d events, %s\n",
+           PHYSICS_NAME, name, stepNs, fastNs, stepNs / fastNs, eventsB, same ? "states match" : "STATES DIFFER");
+    return stepNs / fastNs;
 }
 
-void mouseMove(int x, int y)
+// Long rollouts on the default board, where contacts come every few dozen
+// ticks, and rollout-length ones on the sparse board, where the ball spends
+// most of its time in flight and fast-forward has to pay off at least
+// FF_MIN_SPEEDUP times
+#define FF_MIN_SPEEDUP 8.0
+bool benchFastForward()
 {
-    if (state != STATE_PLAYING) return;
-    float nx = (float)x / (float)g_winW * 2.0f - 1.0f;
-    if (nx < -1.0f + paddleWidth/2) nx = -1.0f + paddleWidth/2;
-    if (nx >  1.0f - paddleWidth/2) nx =  1.0f - paddleWidth/2;
-    paddleX = nx;
+    bool ok = true;
+    fastForwardRollouts("default", useBuiltinBoard, 64, 20000, &ok);
+    double sparse = fastForwardRollouts("sparse", useSparseBoard, FF_MAX_WORLDS, 2500, &ok);
+    if (sparse < FF_MIN_SPEEDUP)
+    {
+        printf("fast-forward: %.1fx on the sparse board, under %.0fx FAIL\n", sparse, FF_MIN_SPEEDUP);
+        ok = false;
+    }
+    return ok;
 }
 
-void handlePauseButtonClick(float nx, float ny)
+// A 60 Hz display simulated against the tick loop, with 3-6 ms of CPU work per
+// frame, 0.5 ms of GPU and a timer that fires up to 1 ms late. Unpaced, the
+// timer is re-armed 16 ms after each tick, so wakes drift across the vblanks:
+// the wait for the flip varies over a whole period and now and then a vblank
+// gets no new frame. With one frame in flight the tick to present latency has
+// to come down, fewer than 2% of vblanks may go without a frame, and the tick
+// clock has to keep to wall time.
+bool benchFramePacing()
 {
-    // check which button clicked (resume/restart/quit)
-    for (int b=0; b<3; b++)
+    const double refresh = 1e6 / 60.0, gpuUs = 500.0, tickUs = 1000.0, t0 = 12345.0;
+    const int frames = 6000;
+    FramePacer saved = pace;
+    double latencyUs[2] = { 0.0, 0.0 }, elapsedUs = 0.0, jitterUs = 0.0;
+    int missed[2] = { 0, 0 }, ticks = 0;
+    for (int paced = 0; paced < 2; ++paced)
     {
-        if (nx >= pauseButtons[b].left && nx <= pauseButtons[b].right &&
-                ny <= pauseButtons[b].top && ny >= pauseButtons[b].bottom)
+        memset(&pace, 0, sizeof(pace));
+        pace.limit = paced;
+        pace.periodUs = PACE_DEFAULT_PERIOD_US;
+        double t = t0, lastFlip = 0.0;
+        ticks = 0;
+        for (int f = 0; f < frames; ++f)
         {
-            const char* lbl = pauseButtons[b].label;
-            if (!strcmp(lbl, "Resume"))
-            {
-                // resume
-                state = STATE_PLAYING;
-                if (pauseStartTimeMs)
-                {
-                    totalPausedMs += glutGet(GLUT_ELAPSED_TIME) - pauseStartTimeMs;
-                    pauseStartTimeMs = 0;
-                }
-            }
-            else if (!strcmp(lbl, "Restart"))
-            {
-                resetGame();
-                state = STATE_PLAYING;
-            }
-            else if (!strcmp(lbl, "Quit"))
+            // wake and tick, set the next wake, then draw and swap
+            int first;
+            pace.tickStartUs = t;
+            ticks += ticksDue((int)(t / 1000.0), &first);
+            double late = 1000.0 * genUnit(genHash(7, (unsigned int)f, 0));
+            double next = t + tickUs + nextTickDelayMs(t + tickUs) * 1000.0 + late;
+            double swap = t + 3000.0 + 3000.0 * genUnit(genHash(7, (unsigned int)f, 1));
+            double flip = std::max(ceil((swap + gpuUs) / refresh) * refresh, lastFlip + refresh);
+            if (f > 0 && flip - lastFlip > refresh * 1.5) missed[paced]++;
+            latencyUs[paced] += flip - t;
+            if (paced)
             {
-                exit(0);
+                paceSwapped(swap);
+                pacePresented(flip);
+                next = std::max(next, flip);    // waited on the fence
             }
-            break;
+            lastFlip = flip;
+            t = next;
         }
+        latencyUs[paced] /= frames;
+        elapsedUs = t - t0;
+        jitterUs = pace.jitterUs / std::max(1, pace.presents);
     }
+    pace = saved;
+
+    double tickRate = ticks * SIM_TICK_MS * 1000.0 / elapsedUs;
+    bool ok = latencyUs[1] < latencyUs[0] && missed[1] * 50 < frames && fabs(tickRate - 1.0) < 0.01;
+    printf("frame pacing: tick to present %.1f ms unpaced, %.1f ms with one in flight; vblanks without a frame "
+           "%d unpaced, %d paced of %d; jitter %.2f ms, tick clock %.3fx wall time %s\n",
+           latencyUs[0] / 1000.0, latencyUs[1] / 1000.0, missed[0], missed[1], frames, jitterUs / 1000.0,
+           tickRate, ok ? "OK" : "FAIL");
+    return ok;
 }
 
-void mouseClick(int button, int mstate, int x, int y)
+// The attract demo played headless for a while. Decisions have to average
+// within the budget and all but the odd one (a preempted thread) finish inside
+// a tick; in -DDXB_ALLOC_TRACK builds the planner must not allocate once warm.
+bool benchAutopilot()
 {
-    if (button == GLUT_LEFT_BUTTON && mstate == GLUT_DOWN)
+    const int ticks = 6000, warmup = 600;
+    World& w = g_attract;
+    int games = 0, lost = 0, bricks = 0;
+    warmPool();
+    useBuiltinBoard(w);     // the demo's cells, which the window gets at startup
+    attractLive = false;
+#ifdef DXB_ALLOC_TRACK
+    int violations = allocStats.violations.load();
+#endif
+    for (int t = 0; t < warmup + ticks; ++t)
     {
-        float nx = (float)x / (float)g_winW * 2.0f - 1.0f;
-        float ny = 1.0f - (float)y / (float)g_winH * 2.0f; // convert to NDC
-
-        if (state == STATE_MENU)
+        if (t == warmup)
         {
-            // Check if clicked on menu buttons
-            float nx = (float)x / (float)g_winW * 2.0f - 1.0f;
-            float ny = 1.0f - (float)y / (float)g_winH * 2.0f;
-
-            // Start Game button area
-            if (nx >= -0.25f && nx <= 0.25f && ny <= 0.10f && ny >= 0.00f)
-            {
-                resetGame();
-                state = STATE_PLAYING;
-                gameStartTimeMs = glutGet(GLUT_ELAPSED_TIME);
-                totalPausedMs = 0;
-                lastSpeedIncreaseCheckMs = gameStartTimeMs;
-                return;
-            }
-
-            // Instructions button area
-            if (nx >= -0.25f && nx <= 0.25f && ny <= -0.05f && ny >= -0.15f)
-            {
-                state = STATE_INSTRUCTIONS;
-                return;
-            }
-
-            // Quit button
-            if (nx >= -0.25f && nx <= 0.25f && ny <= -0.20f && ny >= -0.30f)
-            {
-                exit(0);
-            }
+            allocArm();
+            g_auto.decisions = g_auto.overFrame = 0;
+            g_auto.rollouts = 0;
+            g_auto.totalUs = g_auto.worstUs = 0.0;
         }
-
-        if (state == STATE_INSTRUCTIONS)
+        AllocScope scope(PHASE_TICK);
+        if (!attractLive || w.lives == 0 || w.bricks.aliveCount == 0) games++;
+        stepAttract(t * SIM_TICK_MS);
+        for (int i = 0; i < w.eventCount; ++i)
         {
-            state = STATE_MENU;
-            return;
+            if (w.events[i].kind == EV_LIFE_LOST) lost++;
+            if (w.events[i].kind == EV_BRICK_DESTROYED) bricks++;
+            if (w.events[i].kind == EV_BRICK_EXPLODED) bricks += w.events[i].count;
         }
+    }
+    int n = std::max(1, g_auto.decisions);
+    double meanUs = g_auto.totalUs / n;
+    bool ok = g_auto.decisions > 0 && meanUs < AUTO_BUDGET_US * 1.5 && g_auto.overFrame * 100 <= n;
+#ifdef DXB_ALLOC_TRACK
+    violations = allocStats.violations.load() - violations;
+    if (violations > 0) printf("autopilot: %d allocations in the tick after warm-up\n", violations);
+    ok = ok && violations == 0;
+#endif
+    printf("autopilot: %d decisions, %.0f rollouts and %.2f ms each on %d threads, worst %.2f ms, %d over a tick, "
+           "%d bricks and %d balls lost in %d games %s\n",
+           g_auto.decisions, (double)g_auto.rollouts / n, meanUs / 1000.0, (int)g_pool.threads.size() + 1,
+           g_auto.worstUs / 1000.0, g_auto.overFrame, bricks, lost, games, ok ? "OK" : "FAIL");
+    attractLive = false;
+    clearAnims();
+    return ok;
+}
 
-        if (state == STATE_PLAYING)
+// A board made entirely of explosives, set off in the middle. The whole chain
+// has to resolve inside one call; its frontier outgrows the ring, so the sweep
+// path runs too. The rest of the chain has to come back as one blast event,
+// with the journal holding the last of the cells it took, and one event for
+// all the power-ups they dropped.
+bool benchBlastChain()
+{
+    const int rows = 512, cols = 512;
+    static World w;
+    w.ownedCells.assign((size_t)rows * cols, BRICK_CELL(BRICK_EXPLOSIVE, 1));
+    setBoard(w, w.ownedCells.data(), rows, cols, rows * cols);
+    resetWorld(w, 0, 1);
+    w.eventCount = 0;
+
+    double t0 = nowUs();
+    hitBrick(w, rows / 2, cols / 2, 0.0f, 0.0f);
+    double us = nowUs() - t0;
+
+    bool ok = w.bricks.aliveCount == 0;
+    for (int k = 0; k < rows * cols && ok; ++k) ok = w.bricks.cell[k] == 0;
+    int blasts = 0, spawnEvents = 0, spawned = 0;
+    for (int e = 0; e < w.eventCount; ++e)
+    {
+        const WorldEvent& ev = w.events[e];
+        if (ev.kind == EV_BRICK_EXPLODED)
         {
-            if (!ballMoving && lives > 0)
-                ballMoving = true;
-            return;
+            blasts++;
+            ok = ok && ev.count == rows * cols - 1 && ev.seq + ev.count == w.journal.head;
         }
+        else if (ev.kind == EV_POWERUP_SPAWNED) spawnEvents++, spawned += ev.count;
+    }
+    ok = ok && blasts == 1 && spawnEvents <= 2 && spawned == w.powerUps.count;
+    printf("blast chain: %d explosive bricks cleared in one call, %.0f us, %d events %s\n",
+           rows * cols, us, w.eventCount, ok ? "OK" : "FAIL");
+    return ok;
+}
 
-        if (state == STATE_GAMEOVER || state == STATE_WIN)
+// A 64x64 board of mixed bricks played by the rollout bot, with two copies of
+// the cells kept up to date after every tick: one from the brick journal, one
+// by comparing every cell. Both have to match the board, the journal has to be
+// the cheaper of the two, and a reader that only looks in now and then (so the
+// ring wraps past it) and a board swap have to come back through a rebuild.
+bool benchBrickJournal()
+{
+    const int rows = 64, cols = 64, n = rows * cols, ticks = 20000, lagTicks = 2000;
+    static World w;
+    static unsigned char board[n], byJournal[n], byScan[n], byLagging[n];
+    for (int k = 0; k < n; ++k)
+    {
+        int m = (k / cols * 7 + k % cols * 3) % 13;
+        board[k] = m == 0 ? BRICK_CELL(BRICK_EXPLOSIVE, 1) : m == 1 ? BRICK_CELL(BRICK_STEEL, 1)
+                 : BRICK_CELL(BRICK_NORMAL, 1 + k % 3);
+    }
+    auto newBoard = [&]()
+    {
+        w.ownedCells.assign(board, board + n);
+        int bricks = 0;
+        for (int k = 0; k < n; ++k) bricks += BRICK_BREAKABLE(board[k]);
+        setBoard(w, w.ownedCells.data(), rows, cols, bricks);
+    };
+    newBoard();
+    resetWorld(w, 0, 7);
+    BrickCursor fresh = { 0, 0 }, lagging = { 0, 0 };
+    int rebuilds = 0, lagRebuilds = 0, changes = 0;
+    auto rebuild = [&](unsigned char* copy) { memcpy(copy, w.bricks.cell, n); };
+    auto apply = [&](const BrickChange& e) { byJournal[e.cell] = e.value; changes++; };
+    auto applyLagging = [&](const BrickChange& e) { byLagging[e.cell] = e.value; };
+    if (!readJournal(w, fresh, apply)) rebuild(byJournal), rebuilds++;
+    if (!readJournal(w, lagging, applyLagging)) rebuild(byLagging), lagRebuilds++;
+    rebuild(byScan);
+
+    double journalUs = 0.0, scanUs = 0.0;
+    int diffs = 0;
+    bool ok = true;
+    for (int t = 0; t < ticks; ++t)
+    {
+        int now = t * SIM_TICK_MS;
+        if (t == ticks / 2 || (!w.ball.moving && (w.lives == 0 || w.bricks.aliveCount == 0)))
         {
-            resetGame();
-            state = STATE_PLAYING;
-            return;
+            newBoard();
+            resetWorld(w, now, w.rng);
         }
+        rolloutBot(w, now, 0);
+        stepWorld(w, now);
+
+        double t0 = nowUs();
+        if (!readJournal(w, fresh, apply)) rebuild(byJournal), rebuilds++;
+        double t1 = nowUs();
+        for (int k = 0; k < n; ++k)
+            if (byScan[k] != w.bricks.cell[k]) byScan[k] = w.bricks.cell[k], diffs++;
+        double t2 = nowUs();
+        journalUs += t1 - t0;
+        scanUs += t2 - t1;
+
+        if (t % lagTicks == lagTicks - 1 && !readJournal(w, lagging, applyLagging))
+            rebuild(byLagging), lagRebuilds++;
+        if (t % 256 == 0) ok = ok && !memcmp(byJournal, w.bricks.cell, n);
+    }
+    if (!readJournal(w, lagging, applyLagging)) rebuild(byLagging), lagRebuilds++;
+    ok = ok && !memcmp(byJournal, w.bricks.cell, n) && !memcmp(byScan, w.bricks.cell, n) &&
+         !memcmp(byLagging, w.bricks.cell, n);
+    ok = ok && rebuilds >= 2 && lagRebuilds >= 2 && changes > 0 && journalUs < scanUs;
+    printf("brick journal: %d changes in %d ticks (%d cell changes by scanning, board resets included), "
+           "%.1f ns per tick read vs %.0f ns scanning %d cells, %d and %d rebuilds %s\n",
+           changes, ticks, diffs, journalUs * 1000.0 / ticks, scanUs * 1000.0 / ticks, n,
+           rebuilds, lagRebuilds, ok ? "OK" : "FAIL");
+    return ok;
+}
 
-        if (state == STATE_PAUSED)
+// Score log: submit cost on the game thread, batching, reopening from the
+// index, and recovery of records that were flushed but never indexed
+bool benchScoreLog()
+{
+    const char* path = "bench_scores.dat";
+    const int bursts = 6, perBurst = 48;
+    remove(path);
+    if (!startScoreStore(path))
+    {
+        printf("score log: cannot open %s\n", path);
+        return false;
+    }
+    TopEntry expect[SCORE_TOP_N];
+    for (int k = 0; k < SCORE_TOP_N; ++k) expect[k].score = -1;
+    SessionRecord r;
+    memset(&r, 0, sizeof(r));
+    double worstUs = 0.0;
+    bool ok = true;
+    for (int b = 0; b < bursts; ++b)
+    {
+        for (int i = 0; i < perBurst; ++i)
         {
-            // check if clicked on pause menu buttons
-            handlePauseButtonClick(nx, ny);
-            // clicking outside panel resumes
-            return;
+            r.score = (int)((b * perBurst + i) * 2654435761u % 100000u);
+            r.seed = b * perBurst + i;
+            double t0 = nowUs();
+            ok = submitSession(g_scores, r) && ok;
+            double us = nowUs() - t0;
+            if (us > worstUs) worstUs = us;
+            insertTop(expect, r.score, r.seed);
         }
+        std::this_thread::sleep_for(std::chrono::milliseconds(SCORE_COMMIT_MS * 3 / 2));
+    }
+    stopScoreStore();
+    int commits = g_scores.commits;
+
+    // reopen: the index covers everything, nothing to scan
+    char err[128];
+    double t0 = nowUs();
+    ok = openScoreStore(g_scores, path, err) && ok;
+    double openUs = nowUs() - t0;
+    unsigned int total = bursts * perBurst;
+    ok = ok && g_scores.count == total && !memcmp(g_scores.top, expect, sizeof(expect));
+
+    // a crash after a record flush but before the index flush, then a torn record
+    if (ok)
+    {
+        if (g_scores.count + 2 > scoreCapacity(g_scores)) ok = mapScoreFile(g_scores, g_scores.size + 2 * sizeof(SessionRecord));
+        SessionRecord* tail = scoreRecord(g_scores, g_scores.count);
+        memset(tail, 0, 2 * sizeof(SessionRecord));
+        tail[0].magic = tail[1].magic = RECORD_MAGIC;
+        tail[0].seq = total;
+        tail[0].score = 1000000;
+        tail[0].checksum = recordChecksum(tail[0]);
+        tail[1].seq = total + 1;
+        tail[1].score = 2000000;    // checksum never written
+        flushScoreFile(g_scores, 0, g_scores.size);
     }
+    closeScoreFile(g_scores);
+    ok = ok && openScoreStore(g_scores, path, err);
+    ok = ok && g_scores.count == total + 1 && g_scores.top[0].score == 1000000 && g_scores.top[1].score == expect[0].score;
+    closeScoreFile(g_scores);
+    remove(path);
+
+    ok = ok && commits <= bursts + 1 && worstUs < 1000.0;
+    printf("score log: %u sessions in %d commits, submit worst %.1f us, reopen %.0f us, torn tail recovered %s\n",
+           total, commits, worstUs, openUs, ok ? "OK" : "FAIL");
+    return ok;
 }
 
-// keyboard ascii
-void keyboardASCII(unsigned char key, int x, int y)
+// Metrics: recording cost on the hot path, and totals summed across threads
+bool benchMetrics()
 {
-    if (key == 27) exit(0);
-    if (state == STATE_MENU)
-    {
-        if (key == ' ' || key == '\r')
+    const int iters = 20000000, threads = 4, perThread = 1000000;
+    MetricTotals before, after;
+    readMetrics(before);
+    double t0 = nowUs();
+    for (int i = 0; i < iters; ++i) countMetric(M_TICKS);
+    double counterNs = (nowUs() - t0) * 1000.0 / iters;
+    t0 = nowUs();
+    for (int i = 0; i < iters; ++i) histRecord(H_FRAME_US, (unsigned int)i & 0xffff);
+    double histNs = (nowUs() - t0) * 1000.0 / iters;
+
+    std::vector<std::thread> pool;
+    for (int k = 0; k < threads; ++k)
+        pool.push_back(std::thread([]()
         {
-            resetGame();
-            state = STATE_PLAYING;
-            gameStartTimeMs = glutGet(GLUT_ELAPSED_TIME);
-            totalPausedMs = 0;
-            lastSpeedIncreaseCheckMs = gameStartTimeMs;
-        }
+            for (int i = 0; i < perThread; ++i)
+            {
+                countMetric(M_TICKS);
+                histRecord(H_COLLISIONS_PER_TICK, i % 5);
+            }
+        }));
+    for (size_t k = 0; k < pool.size(); ++k) pool[k].join();
+    readMetrics(after);
+
+    unsigned long long collisions = 0;
+    for (int i = 0; i < HIST_BUCKETS; ++i)
+        collisions += after.buckets[H_COLLISIONS_PER_TICK][i] - before.buckets[H_COLLISIONS_PER_TICK][i];
+    bool ok = after.counters[M_TICKS] - before.counters[M_TICKS] == (unsigned long long)iters + threads * perThread &&
+              collisions == (unsigned long long)threads * perThread &&
+              after.sums[H_COLLISIONS_PER_TICK] - before.sums[H_COLLISIONS_PER_TICK] == 2ull * threads * perThread;
+    for (unsigned int v = 1; v < 4000000000u && ok; v += v / 3 + 1)
+        ok = histBucketMax(histBucket(v)) >= v && (histBucket(v) == 0 || histBucketMax(histBucket(v) - 1) < v);
+
+    std::string text;
+    formatMetrics(text);
+    ok = ok && strstr(text.c_str(), "dxball_frame_time_us_bucket{le=\"+Inf\"}") != NULL;
+    ok = ok && counterNs < 10.0 && histNs < 20.0;
+    printf("metrics: counter %.2f ns, histogram %.2f ns per record, %d threads summed, %u bytes exposition %s\n",
+           counterNs, histNs, threads + 1, (unsigned int)text.size(), ok ? "OK" : "FAIL");
+    return ok;
+}
+
+// Level generator: a 150x150 level at full difficulty per seed, validated
+// tile by tile. Has to stay under 100 ms per 10k bricks and come out the same
+// every time.
+bool benchLevelGen()
+{
+    const int rows = 150, cols = 150, seeds = 4;
+    std::vector<unsigned char> cells, again;
+    double worstMs = 0.0;
+    int minBricks = rows * cols, maxBricks = 0, retries = 0, hard = 0;
+    bool ok = true;
+    for (int k = 0; k < seeds; ++k)
+    {
+        GenStats st;
+        double t0 = nowUs();
+        generateLevel(cells, 100 + k, rows, cols, 1.0f, &st);
+        double ms = (nowUs() - t0) / 1000.0 * 10000.0 / std::max(st.bricks, 1);
+        if (ms > worstMs) worstMs = ms;
+        minBricks = std::min(minBricks, st.bricks);
+        maxBricks = std::max(maxBricks, st.bricks);
+        retries += st.tileRetries;
+        hard += st.hardTiles;
+        generateLevel(again, 100 + k, rows, cols, 1.0f, NULL);
+        ok = ok && cells == again && countSealedBricks(cells.data(), rows, cols) == 0 && st.bricks > 0;
     }
-    else if (state == STATE_PLAYING)
+    ok = ok && worstMs < 100.0;
+    printf("level gen: %dx%d, %d-%d bricks, worst %.1f ms per 10k bricks on %d threads, %d tile retries, %d tiles kept as best effort %s\n",
+           rows, cols, minBricks, maxBricks, worstMs, (int)g_pool.threads.size() + 1, retries, hard,
+           ok ? "OK" : "FAIL");
+    return ok;
+}
+
+int runBenchmarks()
+{
+    bool ok = true;
+    ok = benchAudioMix() && ok;
+    ok = benchLevelSwitch() && ok;
+    ok = benchLevelGen() && ok;
+    ok = benchScoreLog() && ok;
+    ok = benchMetrics() && ok;
+    ok = benchBoardSpecialisation() && ok;
+    ok = benchTallBoard() && ok;
+    ok = benchFrameAllocations() && ok;
+    ok = benchFramePacing() && ok;
+    ok = benchPhysics() && ok;
+    ok = benchFastForward() && ok;
+    ok = benchAutopilot() && ok;
+    ok = benchBlastChain() && ok;
+    ok = benchBrickJournal() && ok;
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    srand(time(NULL));
+
+    // command line: --bench, --legacy-gl, --gl-stats, --audio=device|null|wav:<file>, --no-audio,
+    //   --level <file.dxl>, --campaign <list.txt>, --make-level <file.dxl> <rows> <cols>,
+    //   --quality=auto|low|medium|high, --render-scale=auto|<0.5..1>
+    //   --scores <file>, --no-scores, --metrics-port <port>, --metrics-file <file>,
+    //   --endless[=<seed>], --gen-level <file.dxl> <seed> <rows> <cols>, --attract, --assist,
+    //   --frames-in-flight=1|2
+    AudioSinkKind audioSink = SINK_DEVICE;
+    const char* audioPath = NULL;
+    bool audioOn = true;
+    const char* scorePath = "dxball_scores.dat";
+    int metricsPort = 0;
+    const char* metricsPath = NULL;
+    for (int i = 1; i < argc; ++i)
     {
-        if (key == ' ')
+        if (!strcmp(argv[i], "--bench")) return runBenchmarks();
+        else if (!strcmp(argv[i], "--no-audio")) audioOn = false;
+        else if (!strcmp(argv[i], "--legacy-gl")) useModernGL = false;
+        else if (!strcmp(argv[i], "--gl-stats")) glStats = true;
+        else if (!strncmp(argv[i], "--quality=", 10))
         {
-            if (!ballMoving && lives > 0) ballMoving = true;
+            if (!setQualityByName(argv[i] + 10)) printf("unknown quality %s\n", argv[i] + 10);
         }
-        else if (key == 'p' || key == 'P')
+        else if (!strncmp(argv[i], "--render-scale=", 15))
         {
-            state = STATE_PAUSED;
-            pauseStartTimeMs = glutGet(GLUT_ELAPSED_TIME);
+            if (!setRenderScale(argv[i] + 15)) printf("bad render scale %s\n", argv[i] + 15);
         }
-        else if (key == 'r' || key == 'R')
+        else if (!strcmp(argv[i], "--level") && i + 1 < argc) addCampaignLevel(argv[++i]);
+        else if (!strcmp(argv[i], "--campaign") && i + 1 < argc)
         {
-            resetGame();
+            if (!loadCampaignFile(argv[++i])) printf("campaign %s: no levels\n", argv[i]);
         }
-        else if (key == 'a' || key == 'A')
+        else if (!strcmp(argv[i], "--make-level") && i + 3 < argc)
         {
-            paddleX -= 0.06f;
-            if (paddleX - paddleWidth/2 < -1.0f) paddleX = -1.0f + paddleWidth/2;
+            bool ok = makeLevelFile(argv[i+1], atoi(argv[i+2]), atoi(argv[i+3]));
+            printf("%s %s\n", ok ? "wrote" : "could not write", argv[i+1]);
+            return ok ? 0 : 1;
         }
-        else if (key == 'd' || key == 'D')
+        else if (!strcmp(argv[i], "--scores") && i + 1 < argc) scorePath = argv[++i];
+        else if (!strcmp(argv[i], "--no-scores")) scorePath = NULL;
+        else if (!strcmp(argv[i], "--metrics-port") && i + 1 < argc) metricsPort = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--metrics-file") && i + 1 < argc) metricsPath = argv[++i];
+        else if (!strncmp(argv[i], "--endless", 9))
         {
-            paddleX += 0.06f;
-            if (paddleX + paddleWidth/2 >  1.0f) paddleX =  1.0f - paddleWidth/2;
+            endlessMode = true;
+            endless.seed = argv[i][9] == '=' ? (unsigned int)strtoul(argv[i] + 10, NULL, 10) : newGameSeed();
         }
-    }
-    else if (state == STATE_PAUSED)
-    {
-        if (key == 'p' || key == 'P')
+        else if (!strcmp(argv[i], "--gen-level") && i + 4 < argc)
         {
-            state = STATE_PLAYING;
-            if (pauseStartTimeMs)
+            std::vector<unsigned char> cells;
+            int rows = atoi(argv[i+3]), cols = atoi(argv[i+4]);
+            GenStats st;
+            generateLevel(cells, (unsigned int)strtoul(argv[i+2], NULL, 10), rows, cols, 0.5f, &st);
+            bool ok = writeLevel(argv[i+1], rows, cols, cells.data());
+            printf("%s %s: %d bricks, %d tile retries, %d level retries\n", ok ? "wrote" : "could not write",
+                   argv[i+1], st.bricks, st.tileRetries, st.levelRetries);
+            return ok ? 0 : 1;
+        }
+        else if (!strncmp(argv[i], "--frames-in-flight=", 19))
+        {
+            pace.limit = atoi(argv[i] + 19);
+            if (pace.limit < 1 || pace.limit > PACE_MAX_FRAMES)
             {
-                totalPausedMs += glutGet(GLUT_ELAPSED_TIME) - pauseStartTimeMs;
-                pauseStartTimeMs = 0;
+                printf("bad frames in flight %s\n", argv[i] + 19);
+                pace.limit = 0;
             }
         }
-    }
-    else if (state == STATE_GAMEOVER || state == STATE_WIN)
-    {
-        if (key == 'r' || key == 'R' || key == ' ')
+        else if (!strcmp(argv[i], "--attract")) attractMode = true;
+        else if (!strcmp(argv[i], "--assist")) assistMode = true;
+        else if (!strcmp(argv[i], "--audio=null")) audioSink = SINK_NULL;
+        else if (!strcmp(argv[i], "--audio=device")) audioSink = SINK_DEVICE;
+        else if (!strncmp(argv[i], "--audio=wav:", 12))
         {
-            resetGame();
-            state = STATE_PLAYING;
+            audioSink = SINK_WAV;
+            audioPath = argv[i] + 12;
         }
     }
-}
-
-// arrow keys
-void keyboardSpecial(int key, int x, int y)
-{
-    if (state != STATE_PLAYING) return;
-    const float step = 0.06f;
-    if (key == GLUT_KEY_LEFT)
-    {
-        paddleX -= step;
-        if (paddleX - paddleWidth/2 < -1.0f) paddleX = -1.0f + paddleWidth/2;
-    }
-    else if (key == GLUT_KEY_RIGHT)
-    {
-        paddleX += step;
-        if (paddleX + paddleWidth/2 > 1.0f) paddleX = 1.0f - paddleWidth/2;
-    }
-}
-
-void reshape(int w, int h)
-{
-    g_winW = w;
-    g_winH = h;
-    glViewport(0,0,w,h);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluOrtho2D(-1,1,-1,1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    // recompute brick layout in case spacing needs to adapt in future
-    computeBrickLayout();
-}
-void initPauseButtons()
-{
-    // centered vertically; normalized coordinates (NDC)
-    float bW = 0.30f, bH = 0.10f;
-    float cx = 0.0f, cy = 0.05f;
-    pauseButtons[0] = { cx - bW/2, cx + bW/2, cy + bH/2, cy - bH/2, "Resume" };
-    pauseButtons[1] = { cx - bW/2, cx + bW/2, cy - bH/2 - 0.05f, cy - bH/2 - 0.15f, "Restart" };
-    pauseButtons[2] = { cx - bW/2, cx + bW/2, cy - bH/2 - 0.25f, cy - bH/2 - 0.35f, "Quit" };
-}
 
-int main(int argc, char** argv)
-{
-    srand(time(NULL));
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
     glutInitWindowSize(g_winW, g_winH);
@@ -1187,22 +7448,44 @@ int main(int argc, char** argv)
     // callbacks
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);
-    glutPassiveMotionFunc(mouseMove);
-    glutMouseFunc(mouseClick);
-    glutKeyboardFunc(keyboardASCII);
-    glutSpecialFunc(keyboardSpecial);
+    glutPassiveMotionFunc(mouseMoveInput);
+    glutMouseFunc(mouseClickInput);
+    glutKeyboardFunc(keyboardInput);
+    glutSpecialFunc(keyboardSpecialInput);
     glutTimerFunc(0, update, 0);
 
     // GL state
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (useModernGL && !initGL3())
+    {
+        printf("gl3: falling back to legacy immediate mode\n");
+        useModernGL = false;
+    }
+    initRenderScale();
+    initGpuTimer();
+    if (pace.limit) initFramePacing();
 
     // init game + UI
-    initPauseButtons();
+    initUi();
     state = STATE_MENU;
-    computeBrickLayout();
     resetGame();
 
+#ifdef DXB_ALLOC_TRACK
+    atexit(allocReportAtExit);  // before the rest, so it reports after they stop
+#endif
+    // registered first so it stops last and the file gets the final totals
+    if ((metricsPort || metricsPath) && startMetrics(metricsPort, metricsPath)) atexit(stopMetrics);
+    if (audioOn)
+    {
+        startAudio(audioSink, audioPath);
+        atexit(stopAudio); // every exit path goes through exit()
+    }
+    atexit(stopCampaign);
+    if (attractMode || assistMode) warmPool();
+    if (endlessMode) atexit(waitEndless);   // before the worker pool stops
+    if (scorePath && startScoreStore(scorePath)) atexit(stopScoreStore);
+
     glutMainLoop();
     return 0;
 }